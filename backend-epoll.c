@@ -0,0 +1,65 @@
+#include <unistd.h>
+#include "event-loop.h"
+
+static int event_epoll_init(event_loop_t *event_loop)
+{
+    /*
+     * the size hint of epoll_create is ignored by the kernel, one instance
+     * grows with the interest list, so it is never recreated
+     */
+    event_loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    return event_loop->epoll_fd < 0 ? -1 : 0;
+}
+
+static void event_epoll_fini(event_loop_t *event_loop)
+{
+    if (event_loop->epoll_fd >= 0) {
+        (void)close(event_loop->epoll_fd);
+        event_loop->epoll_fd = -1;
+    }
+}
+
+static int event_epoll_ctl(event_loop_t *event_loop, int op, int fd, uint64_t handle,
+        uint32_t events)
+{
+    struct epoll_event ev;
+
+    ev.data.u64 = handle;
+    ev.events = events;
+
+    return epoll_ctl(event_loop->epoll_fd, op, fd, &ev);
+}
+
+static int event_epoll_add(event_loop_t *event_loop, int fd, uint64_t handle, uint32_t events)
+{
+    return event_epoll_ctl(event_loop, EPOLL_CTL_ADD, fd, handle, events);
+}
+
+static int event_epoll_mod(event_loop_t *event_loop, int fd, uint64_t handle, uint32_t events)
+{
+    return event_epoll_ctl(event_loop, EPOLL_CTL_MOD, fd, handle, events);
+}
+
+static int event_epoll_del(event_loop_t *event_loop, int fd, uint64_t handle)
+{
+    (void)handle;
+
+    return epoll_ctl(event_loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int event_epoll_wait(event_loop_t *event_loop, struct epoll_event *events, int size,
+        int timeout)
+{
+    return epoll_wait(event_loop->epoll_fd, events, size, timeout);
+}
+
+const struct event_backend_ops_s event_backend_epoll = {
+    .name = "epoll",
+    .init = event_epoll_init,
+    .fini = event_epoll_fini,
+    .add = event_epoll_add,
+    .mod = event_epoll_mod,
+    .del = event_epoll_del,
+    .wait = event_epoll_wait,
+};
@@ -0,0 +1,364 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "event-loop.h"
+
+/* user_data of removals, their completions carry nothing for the loop */
+#define EVENT_URING_INTERNAL            EVENT_HANDLE_INVALID
+
+static int event_uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int event_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+        unsigned int flags, void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static void event_uring_unmap(struct event_uring_s *ring)
+{
+    if (ring->sqes != NULL) {
+        (void)munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        (void)munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    if (ring->sq_ring != NULL) {
+        (void)munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+
+    (void)memset(ring, 0, sizeof(struct event_uring_s));
+    ring->fd = -1;
+}
+
+static int event_uring_map(struct event_uring_s *ring, struct io_uring_params *params)
+{
+    char *sq;
+    char *cq;
+    unsigned int i;
+
+    ring->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        return -1;
+    }
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    sq = (char *)ring->sq_ring;
+    cq = (char *)ring->cq_ring;
+    ring->sq_entries = params->sq_entries;
+    ring->sq_head = (unsigned int *)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned int *)(sq + params->sq_off.tail);
+    ring->sq_flags = (unsigned int *)(sq + params->sq_off.flags);
+    ring->sq_mask = *(unsigned int *)(sq + params->sq_off.ring_mask);
+    ring->sq_array = (unsigned int *)(sq + params->sq_off.array);
+    ring->cq_head = (unsigned int *)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned int *)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned int *)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params->cq_off.cqes);
+
+    /* slot i of the array always points at sqe i, sqes are used in ring order */
+    for (i = 0; i < ring->sq_entries; ++i) {
+        ring->sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+static int event_uring_init(event_loop_t *event_loop)
+{
+    struct io_uring_params params;
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    (void)memset(ring, 0, sizeof(struct event_uring_s));
+    (void)memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = EVENT_URING_CQ_ENTRIES;
+    ring->fd = event_uring_setup(EVENT_URING_SQ_ENTRIES, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    /* timed waits and a CQ that never drops completions are relied upon */
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+        (void)close(ring->fd);
+        ring->fd = -1;
+        errno = ENOSYS;
+        return -1;
+    }
+
+    if (event_uring_map(ring, &params) != 0) {
+        (void)close(ring->fd);
+        event_uring_unmap(ring);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void event_uring_fini(event_loop_t *event_loop)
+{
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    if (ring->fd >= 0) {
+        (void)close(ring->fd);
+    }
+
+    event_uring_unmap(ring);
+}
+
+/* hand the queued sqes to the kernel, optionally waiting for completions */
+static int event_uring_submit(event_loop_t *event_loop, unsigned int min_complete, int timeout)
+{
+    int ret;
+    unsigned int flags;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    flags = 0;
+    (void)memset(&arg, 0, sizeof(arg));
+    if (min_complete != 0 || (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED)
+            & IORING_SQ_CQ_OVERFLOW)) {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if (timeout >= 0) {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (long long)(timeout % 1000) * EVENT_NSEC_PER_MSEC;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    }
+
+    ret = event_uring_enter(ring->fd, ring->sq_pending, min_complete, flags,
+            flags != 0 ? &arg : NULL, flags != 0 ? sizeof(arg) : 0);
+    ring->sq_pending = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ret < 0 && (errno == ETIME || errno == EAGAIN || errno == EBUSY)) {
+        return 0;
+    }
+
+    return ret < 0 ? -1 : 0;
+}
+
+static struct io_uring_sqe *event_uring_sqe(event_loop_t *event_loop)
+{
+    unsigned int tail;
+    struct io_uring_sqe *sqe;
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        /* the ring is full of changes, push them out without waiting */
+        if (event_uring_submit(event_loop, 0, 0) != 0
+                || tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[tail & ring->sq_mask];
+    (void)memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    return sqe;
+}
+
+static void event_uring_queue(event_loop_t *event_loop)
+{
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ++ring->sq_pending;
+}
+
+static int event_uring_poll(event_loop_t *event_loop, int fd, uint64_t handle, uint32_t events)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = event_uring_sqe(event_loop);
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    /*
+     * a multishot poll posts on every wakeup, which is what EPOLLET gives;
+     * level and oneshot use a single shot, reaping re-adds the level ones
+     */
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & ~(uint32_t)(EPOLLET | EPOLLONESHOT);
+    if ((events & EPOLLET) && !(events & EPOLLONESHOT)) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = handle;
+    event_uring_queue(event_loop);
+
+    return 0;
+}
+
+static int event_uring_add(event_loop_t *event_loop, int fd, uint64_t handle, uint32_t events)
+{
+    struct stat st;
+
+    /*
+     * files and directories are always ready, their polls end on the first
+     * completion and would be re-armed forever; refuse them like epoll does
+     */
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+
+    if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)) {
+        errno = EPERM;
+        return -1;
+    }
+
+    return event_uring_poll(event_loop, fd, handle, events);
+}
+
+static int event_uring_del(event_loop_t *event_loop, int fd, uint64_t handle)
+{
+    struct io_uring_sqe *sqe;
+
+    (void)fd;
+    sqe = event_uring_sqe(event_loop);
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = handle;
+    sqe->user_data = EVENT_URING_INTERNAL;
+    event_uring_queue(event_loop);
+
+    return 0;
+}
+
+/* sqes run in order, the new poll never matches the removal queued before it */
+static int event_uring_mod(event_loop_t *event_loop, int fd, uint64_t handle, uint32_t events)
+{
+    if (event_uring_del(event_loop, fd, handle) != 0) {
+        return -1;
+    }
+
+    return event_uring_poll(event_loop, fd, handle, events);
+}
+
+/* move completions to the ready buffer, no syscall involved */
+static int event_uring_reap(event_loop_t *event_loop, struct epoll_event *events, int size,
+        int cnt)
+{
+    unsigned int head;
+    unsigned int tail;
+    uint32_t mask;
+    uint64_t handle;
+    event_type_t *event;
+    struct io_uring_cqe *cqe;
+    struct event_uring_s *ring;
+
+    ring = &event_loop->uring;
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail && cnt < size) {
+        cqe = &ring->cqes[head & ring->cq_mask];
+        ++head;
+        handle = cqe->user_data;
+        /* removals, and polls ended by them, report nothing */
+        if (handle == EVENT_URING_INTERNAL || cqe->res == -ECANCELED) {
+            continue;
+        }
+
+        events[cnt].data.u64 = handle;
+        events[cnt].events = cqe->res < 0 ? EPOLLERR : (uint32_t)cqe->res;
+        ++cnt;
+
+        /*
+         * a level poll is done after one report, and the kernel may end a
+         * multishot one on a CQ overflow; both are armed again, the new
+         * poll goes out with the next wait, after the handler ran
+         */
+        if (!(cqe->flags & IORING_CQE_F_MORE) && cqe->res > 0) {
+            event = event_loop_handle_get(event_loop, handle);
+            mask = event != NULL ? event_loop_epoll_mask(event) : EPOLLONESHOT;
+            if (!(mask & EPOLLONESHOT)) {
+                (void)event_uring_poll(event_loop, event->fd, handle, mask);
+            }
+        }
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+    return cnt;
+}
+
+static int event_uring_wait(event_loop_t *event_loop, struct epoll_event *events, int size,
+        int timeout)
+{
+    int wait;
+    struct event_uring_s *ring;
+
+    /*
+     * submit before reaping: polls re-armed by the last reap must not
+     * report again before the handlers of that batch have run
+     */
+    ring = &event_loop->uring;
+    wait = timeout != 0 && *ring->cq_head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (wait || ring->sq_pending != 0
+            || (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) {
+        /* the changelist of the loop goes out with the wait itself */
+        if (event_uring_submit(event_loop, wait ? 1 : 0, timeout) != 0 && wait) {
+            return -1;
+        }
+    }
+
+    return event_uring_reap(event_loop, events, size, 0);
+}
+
+const struct event_backend_ops_s event_backend_uring = {
+    .name = "io_uring",
+    .init = event_uring_init,
+    .fini = event_uring_fini,
+    .add = event_uring_add,
+    .mod = event_uring_mod,
+    .del = event_uring_del,
+    .wait = event_uring_wait,
+};
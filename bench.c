@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include "event-loop.h"
+
+/*
+ * Dispatch rate of read events: every round makes all fds readable and
+ * times the loop draining them. Usage: bench.elf [fds] [rounds]
+ */
+
+static uint64_t dispatched;
+
+static int bench_read(event_type_t *event)
+{
+    ++dispatched;
+
+    return 0;
+}
+
+static uint64_t bench_clock(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * EVENT_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static long bench_fd_limit(long want)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return 1024;
+    }
+
+    if (rl.rlim_cur != RLIM_INFINITY && (long)rl.rlim_cur < want) {
+        rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || (long)rl.rlim_max > want)
+                ? (rlim_t)want : rl.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+        (void)getrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    return rl.rlim_cur == RLIM_INFINITY ? want : (long)rl.rlim_cur;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    int *fds;
+    long n;
+    long limit;
+    int round;
+    int rounds;
+    uint64_t one;
+    uint64_t start;
+    uint64_t elapsed;
+    event_loop_t *loop;
+
+    n = argc > 1 ? atol(argv[1]) : 100000;
+    rounds = argc > 2 ? atoi(argv[2]) : 20;
+    limit = bench_fd_limit(n + 64) - 64;
+    if (n > limit) {
+        (void)fprintf(stderr, "RLIMIT_NOFILE only allows %ld fds\n", limit);
+        n = limit;
+    }
+
+    loop = event_loop_create();
+    fds = (int *)malloc(sizeof(int) * n);
+    if (loop == NULL || fds == NULL || n <= 0) {
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fds[i] < 0 || event_loop_create_read(loop, bench_read, NULL, NULL, fds[i]) == NULL) {
+            (void)fprintf(stderr, "fail to register fd %d\n", i);
+            return -1;
+        }
+    }
+
+    one = 1;
+    elapsed = 0;
+    for (round = 0; round < rounds; ++round) {
+        for (i = 0; i < n; ++i) {
+            if (write(fds[i], &one, sizeof(one)) != sizeof(one)) {
+                return -1;
+            }
+        }
+
+        dispatched = 0;
+        start = bench_clock();
+        while (dispatched < (uint64_t)n) {
+            if (event_loop_run_once(loop) < 0) {
+                return -1;
+            }
+        }
+
+        elapsed += bench_clock() - start;
+    }
+
+    (void)fprintf(stdout, "fds %ld, rounds %d, sizeof(event_type_t) %zu\n",
+            n, rounds, sizeof(event_type_t));
+    (void)fprintf(stdout, "%.1f ns/event, %.0f events/s\n",
+            (double)elapsed / ((double)n * rounds),
+            (double)n * rounds * EVENT_NSEC_PER_SEC / (double)elapsed);
+
+    event_loop_destroy(loop);
+    for (i = 0; i < n; ++i) {
+        (void)close(fds[i]);
+    }
+
+    free(fds);
+
+    return 0;
+}
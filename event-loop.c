@@ -5,277 +5,2131 @@
 #include <limits.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/eventfd.h>
-#include <sys/timerfd.h>
 #include <sys/signalfd.h>
 #include "event-loop.h"
 
-static int event_loop_count_epoll_size(const int fd)
+#ifdef EVENT_LOOP_FIXED
+/* the ready buffer keeps the size it was mapped with */
+static void event_loop_adjust_events(event_loop_t *event_loop, int cnt)
 {
-    int result;
+    (void)event_loop;
+    (void)cnt;
+}
+#else
+static int event_loop_resize_events(event_loop_t *event_loop, int size)
+{
+    struct epoll_event *epoll_events;
+
+    epoll_events = (struct epoll_event *)realloc(event_loop->epoll_events,
+            sizeof(struct epoll_event) * size);
+    if (epoll_events == NULL) {
+        return -1;
+    }
+
+    event_loop->epoll_events = epoll_events;
+    event_loop->epoll_events_size = size;
+    event_loop->epoll_events_idle = 0;
+
+    return 0;
+}
+
+/*
+ * size the ready buffer by what epoll_wait actually returns: double it
+ * when a wait fills it up, halve it after a long run of mostly empty waits
+ */
+static void event_loop_adjust_events(event_loop_t *event_loop, int cnt)
+{
+    int size;
+
+    size = event_loop->epoll_events_size;
+    if (cnt >= size) {
+        if (size < EVENT_LOOP_EVENTS_MAX) {
+            (void)event_loop_resize_events(event_loop, size << 1);
+        }
+    } else if (cnt < (size >> 2) && size > EVENT_LOOP_EVENTS_MIN) {
+        if (++event_loop->epoll_events_idle >= EVENT_LOOP_EVENTS_SHRINK) {
+            (void)event_loop_resize_events(event_loop, size >> 1);
+        }
+    } else {
+        event_loop->epoll_events_idle = 0;
+    }
+}
+#endif
+
+/* the dispatch path must only have to pull in the first cache line */
+_Static_assert(offsetof(event_type_t, timer) == EVENT_CACHELINE_SIZE,
+        "hot fields of event_type_t overflow their cache line");
+
+static uint64_t event_loop_clock(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * EVENT_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t event_timespec_to_nsec(const struct timespec *ts)
+{
+    if (ts->tv_sec < 0 || ts->tv_nsec < 0) {
+        return 0;
+    }
+
+    return (uint64_t)ts->tv_sec * EVENT_NSEC_PER_SEC + (uint64_t)ts->tv_nsec;
+}
+
+void event_loop_update_time(event_loop_t *event_loop)
+{
+    if (event_loop != NULL) {
+        event_loop->time_now = event_loop_clock();
+    }
+}
+
+static void event_timer_wheel_init(struct event_timer_wheel_s *wheel, uint64_t now)
+{
+    int i;
+    int j;
+
+    wheel->jiffies = now / EVENT_TIMER_TICK_NSEC;
+    wheel->size = 0;
+    for (i = 0; i < EVENT_TIMER_TVR_SIZE; ++i) {
+        INIT_LIST_HEAD(wheel->tv1 + i);
+    }
+
+    for (i = 0; i < EVENT_TIMER_TVN_LEVELS; ++i) {
+        for (j = 0; j < EVENT_TIMER_TVN_SIZE; ++j) {
+            INIT_LIST_HEAD(wheel->tvn[i] + j);
+        }
+    }
+}
+
+static void event_timer_wheel_insert(struct event_timer_wheel_s *wheel, event_type_t *event)
+{
+    int i;
+    uint64_t idx;
+    uint64_t expires;
+    struct list_head *vec;
+
+    expires = event->timer.expires;
+    idx = expires - wheel->jiffies;
+    if ((int64_t)idx < 0) {
+        /* already due, run it on the next tick */
+        vec = wheel->tv1 + (wheel->jiffies & EVENT_TIMER_TVR_MASK);
+    } else if (idx < EVENT_TIMER_TVR_SIZE) {
+        vec = wheel->tv1 + (expires & EVENT_TIMER_TVR_MASK);
+    } else {
+        /* beyond the wheel, park it on the last slot and re-queue it from there */
+        if (idx > EVENT_TIMER_MAX_TICKS) {
+            idx = EVENT_TIMER_MAX_TICKS;
+            expires = wheel->jiffies + idx;
+            event->timer.expires = expires;
+        }
+
+        for (i = 0; i < EVENT_TIMER_TVN_LEVELS - 1; ++i) {
+            if (idx < (1ULL << (EVENT_TIMER_TVR_BITS + (i + 1) * EVENT_TIMER_TVN_BITS))) {
+                break;
+            }
+        }
+
+        vec = wheel->tvn[i] + ((expires >> (EVENT_TIMER_TVR_BITS + i * EVENT_TIMER_TVN_BITS))
+                & EVENT_TIMER_TVN_MASK);
+    }
+
+    list_add_tail(&event->timer.node, vec);
+}
+
+static void event_timer_wheel_cascade(struct event_timer_wheel_s *wheel, struct list_head *tv,
+        int index)
+{
+    event_type_t *event;
+    event_type_t *tmp;
+    struct list_head work;
+
+    INIT_LIST_HEAD(&work);
+    list_splice_init(tv + index, &work);
+    list_for_each_entry_safe(event, tmp, &work, timer.node) {
+        event_timer_wheel_insert(wheel, event);
+    }
+}
+
+/* the first tick at which a timer may expire, a lower bound for the upper levels */
+static uint64_t event_timer_wheel_next(struct event_timer_wheel_s *wheel)
+{
+    int i;
+    int d;
+    int shift;
+    int index;
+    uint64_t base;
+    uint64_t tick;
+    uint64_t best;
+
+    best = UINT64_MAX;
+    index = wheel->jiffies & EVENT_TIMER_TVR_MASK;
+    for (i = 0; i < EVENT_TIMER_TVR_SIZE; ++i) {
+        if (!list_empty(wheel->tv1 + ((index + i) & EVENT_TIMER_TVR_MASK))) {
+            best = wheel->jiffies + i;
+            break;
+        }
+    }
+
+    for (i = 0; i < EVENT_TIMER_TVN_LEVELS; ++i) {
+        shift = EVENT_TIMER_TVR_BITS + i * EVENT_TIMER_TVN_BITS;
+        base = wheel->jiffies >> shift;
+        /* the slot under jiffies is only due now if it has not been cascaded yet */
+        d = (wheel->jiffies & ((1ULL << shift) - 1)) ? 1 : 0;
+        for (index = d + EVENT_TIMER_TVN_SIZE; d < index; ++d) {
+            tick = (base + d) << shift;
+            if (tick >= best) {
+                break;
+            }
+
+            if (!list_empty(wheel->tvn[i] + ((base + d) & EVENT_TIMER_TVN_MASK))) {
+                best = tick;
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+static void event_timer_tree_insert(struct event_timer_tree_s *tree, event_type_t *event)
+{
+    int leftmost;
+    struct rb_node **new;
+    struct rb_node *parent;
+    event_type_t *entry;
+
+    leftmost = 1;
+    new = &tree->root.rb_root.rb_node;
+    parent = NULL;
+    while (*new != NULL) {
+        parent = *new;
+        entry = rb_entry(parent, event_type_t, timer.rb);
+        /* equal deadlines go right, so they fire in arming order */
+        if (event->timer.expires < entry->timer.expires) {
+            new = &parent->rb_left;
+        } else {
+            new = &parent->rb_right;
+            leftmost = 0;
+        }
+    }
+
+    rb_link_node(&event->timer.rb, parent, new);
+    rb_insert_color_cached(&event->timer.rb, &tree->root, leftmost);
+}
+
+/*
+ * pick the point in [expires, expires + slack] with the most trailing zero
+ * bits, so timers whose windows overlap land on the same tick or deadline
+ * and are handled by a single wakeup, as the kernel does with timer_slack
+ */
+static uint64_t event_timer_apply_slack(uint64_t expires, uint64_t slack)
+{
+    int bit;
+    uint64_t mask;
+    uint64_t limit;
+
+    if (slack == 0) {
+        return expires;
+    }
+
+    limit = expires + slack;
+    if (limit < expires) {
+        limit = UINT64_MAX;
+    }
+
+    mask = expires ^ limit;
+    if (mask == 0) {
+        return expires;
+    }
+
+    bit = 63 - __builtin_clzll(mask);
+    mask = (1ULL << bit) - 1;
+
+    return limit & ~mask;
+}
+
+static void event_timer_arm(event_loop_t *event_loop, event_type_t *event, uint64_t deadline)
+{
+    event->timer.deadline = deadline;
+    if (event_loop->timer_engine == EVENT_TIMER_RBTREE) {
+        event->timer.expires = event_timer_apply_slack(deadline, event->timer.slack);
+        event_timer_tree_insert(&event_loop->timer_tree, event);
+        ++event_loop->timer_tree.size;
+        return;
+    }
+
+    event->timer.expires = event_timer_apply_slack(
+            (deadline + EVENT_TIMER_TICK_NSEC - 1) / EVENT_TIMER_TICK_NSEC,
+            event->timer.slack / EVENT_TIMER_TICK_NSEC);
+    event_timer_wheel_insert(&event_loop->timer_wheel, event);
+    ++event_loop->timer_wheel.size;
+}
+
+static void event_timer_disarm(event_loop_t *event_loop, event_type_t *event)
+{
+    if (event->flag & EVENT_F_PENDING) {
+        list_del_init(&event->timer.node);
+        event->flag &= ~EVENT_F_PENDING;
+    } else if (!RB_EMPTY_NODE(&event->timer.rb)) {
+        rb_erase_cached(&event->timer.rb, &event_loop->timer_tree.root);
+        RB_CLEAR_NODE(&event->timer.rb);
+        --event_loop->timer_tree.size;
+    } else if (!list_empty(&event->timer.node)) {
+        list_del_init(&event->timer.node);
+        --event_loop->timer_wheel.size;
+    }
+}
+
+static int event_timer_queued(event_type_t *event)
+{
+    return !list_empty(&event->timer.node) || !RB_EMPTY_NODE(&event->timer.rb);
+}
+
+static int event_timer_armed(event_loop_t *event_loop)
+{
+    return event_loop->timer_wheel.size != 0 || event_loop->timer_tree.size != 0
+            || !list_empty(&event_loop->timer_pending);
+}
+
+int event_loop_set_timer_engine(event_loop_t *event_loop, enum event_timer_engine_e engine)
+{
+    if (event_loop == NULL || (engine != EVENT_TIMER_WHEEL && engine != EVENT_TIMER_RBTREE)) {
+        return -1;
+    }
+
+    /* armed timers cannot be carried from one engine to the other */
+    if (engine != event_loop->timer_engine && event_timer_armed(event_loop)) {
+        return -1;
+    }
+
+    event_loop->timer_engine = engine;
+
+    return 0;
+}
+
+/*
+ * queue a due timer for dispatch; an idle timeout is only checked here, so
+ * when I/O moved it on since it was armed it is simply armed again
+ */
+static void event_timer_expire(event_loop_t *event_loop, event_type_t *event)
+{
+    uint64_t deadline;
+
+    if (event->type == EVENT_TYPE_READ) {
+        deadline = event->touched + event->timer.interval;
+        if (deadline > event_loop->time_now) {
+            event_timer_arm(event_loop, event, deadline);
+            return;
+        }
+    }
+
+    list_add_tail(&event->timer.node, &event_loop->timer_pending);
+    event->flag |= EVENT_F_PENDING;
+}
+
+static void event_timer_tree_run(event_loop_t *event_loop)
+{
+    struct rb_node *node;
+    event_type_t *event;
+    struct event_timer_tree_s *tree;
+
+    tree = &event_loop->timer_tree;
+    while ((node = rb_first_cached(&tree->root)) != NULL) {
+        event = rb_entry(node, event_type_t, timer.rb);
+        if (event->timer.expires > event_loop->time_now) {
+            break;
+        }
+
+        rb_erase_cached(node, &tree->root);
+        RB_CLEAR_NODE(node);
+        --tree->size;
+        event_timer_expire(event_loop, event);
+    }
+}
+
+/* move every timer due by time_now to timer_pending */
+static void event_timer_run(event_loop_t *event_loop)
+{
+    int i;
+    int index;
+    uint64_t now;
+    event_type_t *event;
+    event_type_t *tmp;
+    struct list_head work;
+    struct event_timer_wheel_s *wheel;
+
+    if (event_loop->timer_engine == EVENT_TIMER_RBTREE) {
+        event_timer_tree_run(event_loop);
+        return;
+    }
+
+    wheel = &event_loop->timer_wheel;
+    now = event_loop->time_now / EVENT_TIMER_TICK_NSEC;
+    while (wheel->size != 0 && wheel->jiffies <= now) {
+        index = wheel->jiffies & EVENT_TIMER_TVR_MASK;
+        if (index == 0) {
+            for (i = 0; i < EVENT_TIMER_TVN_LEVELS; ++i) {
+                index = (wheel->jiffies >> (EVENT_TIMER_TVR_BITS + i * EVENT_TIMER_TVN_BITS))
+                        & EVENT_TIMER_TVN_MASK;
+                event_timer_wheel_cascade(wheel, wheel->tvn[i], index);
+                if (index != 0) {
+                    break;
+                }
+            }
+
+            index = 0;
+        }
+
+        ++wheel->jiffies;
+        INIT_LIST_HEAD(&work);
+        list_splice_init(wheel->tv1 + index, &work);
+        list_for_each_entry_safe(event, tmp, &work, timer.node) {
+            if (event->timer.deadline > event_loop->time_now) {
+                event_timer_wheel_insert(wheel, event);
+            } else {
+                --wheel->size;
+                event_timer_expire(event_loop, event);
+            }
+        }
+    }
+
+    if (wheel->jiffies <= now) {
+        wheel->jiffies = now + 1;
+    }
+}
+
+static event_type_t *event_timer_pop(event_loop_t *event_loop)
+{
+    event_type_t *event;
+
+    if (list_empty(&event_loop->timer_pending)) {
+        return NULL;
+    }
+
+    event = list_first_entry(&event_loop->timer_pending, event_type_t, timer.node);
+    list_del_init(&event->timer.node);
+    event->flag = (event->flag & ~EVENT_F_PENDING) | EVENT_F_EXPIRED;
+    event->revents = 0;
+
+    return event;
+}
+
+/* epoll_wait timeout in milliseconds until the next timer is due */
+static int event_timer_timeout(event_loop_t *event_loop)
+{
+    uint64_t next;
+    uint64_t diff;
+    struct rb_node *node;
+
+    if (!list_empty(&event_loop->timer_pending)) {
+        return 0;
+    }
+
+    if (event_loop->timer_engine == EVENT_TIMER_RBTREE) {
+        node = rb_first_cached(&event_loop->timer_tree.root);
+        if (node == NULL) {
+            return -1;
+        }
+
+        next = rb_entry(node, event_type_t, timer.rb)->timer.expires;
+    } else {
+        if (event_loop->timer_wheel.size == 0) {
+            return -1;
+        }
+
+        next = event_timer_wheel_next(&event_loop->timer_wheel);
+        if (next > UINT64_MAX / EVENT_TIMER_TICK_NSEC) {
+            return -1;
+        }
+
+        next *= EVENT_TIMER_TICK_NSEC;
+    }
+
+    if (next <= event_loop->time_now) {
+        return 0;
+    }
+
+    diff = (next - event_loop->time_now + EVENT_NSEC_PER_MSEC - 1) / EVENT_NSEC_PER_MSEC;
+    if (diff > INT_MAX) {
+        return INT_MAX;
+    }
+
+    return (int)diff;
+}
+
+/* the interest set of an event, EPOLLOUT only while its output is blocked */
+uint32_t event_loop_epoll_mask(event_type_t *event)
+{
+    uint32_t events;
+
+    switch (event->type) {
+    case EVENT_TYPE_READ:
+        /*
+         * a peer close is told apart from data without another read, but
+         * epoll refuses EPOLLRDHUP together with EPOLLEXCLUSIVE
+         */
+        events = (event->flag & EVENT_F_MUTED) ? 0 : EPOLLIN;
+        if (events != 0 && !(event->flag & EVENT_F_EXCLUSIVE)) {
+            events |= EPOLLRDHUP;
+        }
+        if (event->stream != NULL && event->stream->output.blocked) {
+            events |= EPOLLOUT;
+        }
+        break;
+    case EVENT_TYPE_WRITE:
+        /* errors and hang-ups are always reported */
+        events = 0;
+        if (event->stream != NULL && event->stream->output.blocked) {
+            events |= EPOLLOUT;
+        }
+        break;
+    case EVENT_TYPE_SIGNAL:
+        events = (event->flag & EVENT_F_MUTED) ? 0 : EPOLLIN;
+        break;
+    case EVENT_TYPE_LINUX_EVENT:
+        events = (event->flag & EVENT_F_MUTED) ? 0 : EPOLLIN | EPOLLOUT;
+        break;
+    default:
+        return 0;
+    }
+
+    if (event->flag & EVENT_F_ARM_ONCE) {
+        return events | EPOLLONESHOT;
+    } else if (event->flag & EVENT_F_EXCLUSIVE) {
+        return events | EPOLLEXCLUSIVE;
+    } else if (event->flag & EVENT_F_LEVEL) {
+        return events;
+    }
+
+    return events | EPOLLET;
+}
+
+#ifdef EVENT_LOOP_FIXED
+/* the fd table was mapped at its full size */
+static int event_loop_reserve_fd(event_loop_t *event_loop, int fd)
+{
+    return fd < event_loop->fd_table_size ? 0 : -1;
+}
+#else
+/* grow the fd table geometrically until fd fits */
+static int event_loop_reserve_fd(event_loop_t *event_loop, int fd)
+{
+    int size;
+    event_type_t **fd_table;
+
+    if (fd < event_loop->fd_table_size) {
+        return 0;
+    }
+
+    size = event_loop->fd_table_size;
+    if (size == 0) {
+        size = EVENT_LOOP_FD_TABLE_MIN;
+    }
+
+    while (size <= fd) {
+        if (size > INT_MAX >> 1) {
+            size = INT_MAX;
+            break;
+        }
+
+        size <<= 1;
+    }
+
+    fd_table = (event_type_t **)realloc(event_loop->fd_table, sizeof(event_type_t *) * size);
+    if (fd_table == NULL) {
+        return -1;
+    }
+
+    (void)memset(fd_table + event_loop->fd_table_size, 0,
+            sizeof(event_type_t *) * (size - event_loop->fd_table_size));
+    event_loop->fd_table = fd_table;
+    event_loop->fd_table_size = size;
+
+    return 0;
+}
+#endif
+
+/* chain slots [from, size) in index order in front of next */
+static void event_loop_link_handles(struct event_handle_slot_s *table, uint32_t from,
+        uint32_t size, uint32_t next)
+{
+    uint32_t i;
+
+    for (i = from; i < size; ++i) {
+        table[i].event = NULL;
+        table[i].gen = 1;
+        table[i].next = i + 1 < size ? i + 1 : next;
+    }
+}
+
+#ifdef EVENT_LOOP_FIXED
+/* the handle table was mapped and linked at its full size */
+static int event_loop_grow_handles(event_loop_t *event_loop)
+{
+    (void)event_loop;
+
+    return -1;
+}
+#else
+static int event_loop_grow_handles(event_loop_t *event_loop)
+{
+    uint32_t size;
+    struct event_handle_slot_s *table;
+
+    size = event_loop->handle_table_size;
+    size = size == 0 ? EVENT_LOOP_HANDLE_TABLE_MIN : size << 1;
+    if (size <= event_loop->handle_table_size) {
+        return -1;
+    }
+
+    table = (struct event_handle_slot_s *)realloc(event_loop->handle_table,
+            sizeof(struct event_handle_slot_s) * size);
+    if (table == NULL) {
+        return -1;
+    }
+
+    event_loop_link_handles(table, event_loop->handle_table_size, size, event_loop->handle_free);
+    event_loop->handle_free = event_loop->handle_table_size;
+    event_loop->handle_table = table;
+    event_loop->handle_table_size = size;
+
+    return 0;
+}
+#endif
+
+static int event_loop_alloc_handle(event_loop_t *event_loop, event_type_t *event)
+{
+    uint32_t index;
+    struct event_handle_slot_s *slot;
+
+    if (event_loop->handle_free == UINT32_MAX && event_loop_grow_handles(event_loop) != 0) {
+        return -1;
+    }
+
+    index = event_loop->handle_free;
+    slot = &event_loop->handle_table[index];
+    event_loop->handle_free = slot->next;
+    slot->event = event;
+    event->handle = EVENT_HANDLE_MAKE(slot->gen, index);
+
+    return 0;
+}
+
+static void event_loop_free_handle(event_loop_t *event_loop, event_type_t *event)
+{
+    uint32_t index;
+    struct event_handle_slot_s *slot;
+
+    index = EVENT_HANDLE_INDEX(event->handle);
+    slot = &event_loop->handle_table[index];
+    slot->event = NULL;
+    if (++slot->gen == 0) {
+        slot->gen = 1;
+    }
+
+    slot->next = event_loop->handle_free;
+    event_loop->handle_free = index;
+    event->handle = EVENT_HANDLE_INVALID;
+}
+
+/* the event behind a handle, NULL if it has been cancelled since */
+static inline event_type_t *event_loop_handle_lookup(event_loop_t *event_loop,
+        event_handle_t handle)
+{
+    struct event_handle_slot_s *slot;
+
+    if (EVENT_HANDLE_INDEX(handle) >= event_loop->handle_table_size) {
+        return NULL;
+    }
+
+    slot = &event_loop->handle_table[EVENT_HANDLE_INDEX(handle)];
+    if (slot->gen != EVENT_HANDLE_GEN(handle)) {
+        return NULL;
+    }
+
+    return slot->event;
+}
+
+/* push the recorded interest changes to the backend, once before each wait */
+static void event_loop_apply_changes(event_loop_t *event_loop)
+{
+    int i;
+    uint32_t mask;
+    event_type_t *event;
+
+    for (i = 0; i < event_loop->changes_size; ++i) {
+        /* cancelled before the backend ever heard of it */
+        event = event_loop_handle_lookup(event_loop, event_loop->changes[i]);
+        if (event == NULL) {
+            continue;
+        }
+
+        event->flag &= ~EVENT_F_CHANGED;
+        mask = event_loop_epoll_mask(event);
+        /*
+         * the kernel disabled it after the report, input waits for the
+         * re-arm but a blocked output is still polled so that it drains
+         */
+        if ((event->flag & EVENT_F_ACTIVE) && (event->flag & EVENT_F_DISARMED)) {
+            if (!(mask & EPOLLOUT)) {
+                continue;
+            }
+
+            mask &= ~(uint32_t)(EPOLLIN | EPOLLRDHUP);
+        }
+
+        /* EPOLL_CTL_MOD refuses exclusive entries */
+        if ((event->flag & EVENT_F_ACTIVE) && (event->flag & EVENT_F_EXCLUSIVE)) {
+            (void)event_loop->backend->del(event_loop, event->fd, event->handle);
+            event->flag &= ~EVENT_F_ACTIVE;
+        }
+
+        if (event->flag & EVENT_F_ACTIVE) {
+            (void)event_loop->backend->mod(event_loop, event->fd, event->handle, mask);
+        } else if (event_loop->backend->add(event_loop, event->fd, event->handle, mask) == 0) {
+            event->flag |= EVENT_F_ACTIVE;
+        } else {
+            event->revents = EPOLLERR;
+            list_move_tail(&event->node, &event_loop->report_pending);
+        }
+    }
+
+    event_loop->changes_size = 0;
+}
+
+/* the mask is read when the change is applied, so each event is listed once */
+static void event_loop_record_change(event_loop_t *event_loop, event_type_t *event)
+{
+    if (event->flag & EVENT_F_CHANGED) {
+        return;
+    }
+
+    if (event_loop->changes_size == EVENT_LOOP_CHANGES_MAX) {
+        event_loop_apply_changes(event_loop);
+    }
+
+    event->flag |= EVENT_F_CHANGED;
+    event_loop->changes[event_loop->changes_size++] = event->handle;
+}
+
+static int event_loop_active_event(event_loop_t *event_loop, event_type_t *event)
+{
+    /* timers live on the wheel and never reach the backend */
+    if (event->type != EVENT_TYPE_TIMER) {
+        event_loop_record_change(event_loop, event);
+    }
+
+    return 0;
+}
+
+static void event_loop_modify_event(event_loop_t *event_loop, event_type_t *event)
+{
+    event_loop_record_change(event_loop, event);
+}
+
+/*
+ * a pending add is simply dropped with the handle, a registration the
+ * backend holds goes now: the caller may close the fd right after
+ */
+static void event_loop_deactive_event(event_loop_t *event_loop, event_type_t *event)
+{
+    if (event->flag & EVENT_F_ACTIVE) {
+        (void)event_loop->backend->del(event_loop, event->fd, event->handle);
+    }
+
+    event->flag &= ~(EVENT_F_CHANGED | EVENT_F_ACTIVE | EVENT_F_DISARMED | EVENT_F_MUTED);
+}
+
+static int event_loop_add_event(event_loop_t *event_loop, event_type_t *event)
+{
+    int ret;
+
+    if (event->fd >= 0 && event_loop_reserve_fd(event_loop, event->fd) != 0) {
+        return -1;
+    }
+
+    /* the deferred add no longer lets epoll_ctl() catch a second event on the fd */
+    if (event->fd >= 0 && event_loop->fd_table[event->fd] != NULL) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    if (event_loop_alloc_handle(event_loop, event) != 0) {
+        return -1;
+    }
+
+    ret = event_loop_active_event(event_loop, event);
+    if (ret != 0) {
+        event_loop_free_handle(event_loop, event);
+    } else {
+        ++event_loop->event_size;
+        event->loop = event_loop;
+        list_add_tail(&event->node, &event_loop->event_head);
+        if (event->fd >= 0) {
+            event_loop->fd_table[event->fd] = event;
+        }
+    }
+
+    return ret;
+}
+
+event_type_t *event_loop_find_by_fd(event_loop_t *event_loop, int fd)
+{
+    if (event_loop == NULL || fd < 0 || fd >= event_loop->fd_table_size) {
+        return NULL;
+    }
+
+    return event_loop->fd_table[fd];
+}
+
+event_type_t *event_loop_handle_get(event_loop_t *event_loop, event_handle_t handle)
+{
+    if (event_loop == NULL) {
+        return NULL;
+    }
+
+    return event_loop_handle_lookup(event_loop, handle);
+}
+
+int event_loop_handle_cancel(event_loop_t *event_loop, event_handle_t handle)
+{
+    event_type_t *event;
+
+    event = event_loop_handle_get(event_loop, handle);
+    if (event == NULL) {
+        return -1;
+    }
+
+    event_loop_cancel(event);
+
+    return 0;
+}
+
+int event_loop_cancel_by_fd(event_loop_t *event_loop, int fd)
+{
+    event_type_t *event;
+
+    event = event_loop_find_by_fd(event_loop, fd);
+    if (event == NULL) {
+        return -1;
+    }
+
+    event_loop_cancel(event);
+
+    return 0;
+}
+
+/* give back everything event_loop_create() set up, the loop included */
+static void event_loop_release(event_loop_t *event_loop)
+{
+#ifdef EVENT_LOOP_FIXED
+    (void)munmap(event_loop->fixed_map, event_loop->fixed_size);
+#else
+    slab_destroy(&event_loop->event_slab);
+    slab_destroy(&event_loop->hook_slab);
+    slab_destroy(&event_loop->sigset_slab);
+    slab_destroy(&event_loop->stream_slab);
+    slab_destroy(&event_loop->segment_slab);
+    slab_destroy(&event_loop->buffer_slab);
+    free(event_loop->scratch.base);
+    free(event_loop->handle_table);
+    free(event_loop->fd_table);
+    free(event_loop->epoll_events);
+    free(event_loop);
+#endif
+}
+
+#ifdef EVENT_LOOP_FIXED
+/* reserve size bytes at *offset, every table starts on a cache line */
+static size_t event_loop_fixed_carve(size_t *offset, size_t size)
+{
+    size_t at;
+
+    at = *offset;
+    *offset += (size + EVENT_CACHELINE_SIZE - 1) & ~((size_t)EVENT_CACHELINE_SIZE - 1);
+
+    return at;
+}
+
+/*
+ * The loop followed by every table it would otherwise allocate, faulted
+ * in and locked up front so that dispatch never takes a page fault.
+ */
+static event_loop_t *event_loop_map_fixed(void)
+{
+    char *map;
+    size_t size;
+    size_t events_at;
+    size_t fds_at;
+    size_t handles_at;
+    size_t slab_at;
+    size_t hooks_at;
+    size_t sigsets_at;
+    size_t streams_at;
+    size_t segments_at;
+    size_t buffers_at;
+    size_t scratch_at;
+    event_loop_t *event_loop;
+
+    size = 0;
+    (void)event_loop_fixed_carve(&size, sizeof(event_loop_t));
+    events_at = event_loop_fixed_carve(&size, sizeof(struct epoll_event) * EVENT_LOOP_FIXED_READY);
+    fds_at = event_loop_fixed_carve(&size, sizeof(event_type_t *) * EVENT_LOOP_FIXED_FDS);
+    handles_at = event_loop_fixed_carve(&size,
+            sizeof(struct event_handle_slot_s) * EVENT_LOOP_FIXED_EVENTS);
+    slab_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(sizeof(event_type_t), EVENT_LOOP_FIXED_EVENTS));
+    hooks_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(sizeof(struct event_ps_hook_s), EVENT_LOOP_FIXED_HOOKS));
+    sigsets_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(sizeof(sigset_t), EVENT_LOOP_FIXED_SIGNALS));
+    streams_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(sizeof(struct event_stream_s), EVENT_LOOP_FIXED_STREAMS));
+    segments_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(EVENT_OUTPUT_SEGMENT_SIZE, EVENT_LOOP_FIXED_SEGMENTS));
+    buffers_at = event_loop_fixed_carve(&size,
+            slab_fixed_size(EVENT_INPUT_BUFFER_SIZE, EVENT_LOOP_FIXED_BUFFERS));
+    scratch_at = event_loop_fixed_carve(&size, EVENT_LOOP_FIXED_SCRATCH);
+
+    map = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (mlock(map, size) != 0) {
+        (void)munmap(map, size);
+        return NULL;
+    }
+
+    /* anonymous memory is zeroed, the fd table starts out empty */
+    event_loop = (event_loop_t *)map;
+    event_loop->fixed_map = map;
+    event_loop->fixed_size = size;
+    event_loop->epoll_events = (struct epoll_event *)(map + events_at);
+    event_loop->epoll_events_size = EVENT_LOOP_FIXED_READY;
+    event_loop->epoll_events_idle = 0;
+    event_loop->fd_table = (event_type_t **)(map + fds_at);
+    event_loop->fd_table_size = EVENT_LOOP_FIXED_FDS;
+    event_loop->handle_table = (struct event_handle_slot_s *)(map + handles_at);
+    event_loop->handle_table_size = EVENT_LOOP_FIXED_EVENTS;
+    event_loop->handle_free = 0;
+    event_loop_link_handles(event_loop->handle_table, 0, EVENT_LOOP_FIXED_EVENTS, UINT32_MAX);
+    slab_init_fixed(&event_loop->event_slab, sizeof(event_type_t), map + slab_at,
+            EVENT_LOOP_FIXED_EVENTS);
+    slab_init_fixed(&event_loop->hook_slab, sizeof(struct event_ps_hook_s), map + hooks_at,
+            EVENT_LOOP_FIXED_HOOKS);
+    slab_init_fixed(&event_loop->sigset_slab, sizeof(sigset_t), map + sigsets_at,
+            EVENT_LOOP_FIXED_SIGNALS);
+    slab_init_fixed(&event_loop->stream_slab, sizeof(struct event_stream_s), map + streams_at,
+            EVENT_LOOP_FIXED_STREAMS);
+    slab_init_fixed(&event_loop->segment_slab, EVENT_OUTPUT_SEGMENT_SIZE, map + segments_at,
+            EVENT_LOOP_FIXED_SEGMENTS);
+    slab_init_fixed(&event_loop->buffer_slab, EVENT_INPUT_BUFFER_SIZE, map + buffers_at,
+            EVENT_LOOP_FIXED_BUFFERS);
+    event_loop->scratch.base = map + scratch_at;
+    event_loop->scratch.size = EVENT_LOOP_FIXED_SCRATCH;
+
+    return event_loop;
+}
+#endif
+
+event_loop_t *event_loop_create(void)
+{
+    event_loop_t *event_loop;
+
+#ifdef EVENT_LOOP_FIXED
+    event_loop = event_loop_map_fixed();
+#else
+    event_loop = (event_loop_t *)malloc(sizeof(event_loop_t));
+#endif
+    if (event_loop == NULL) {
+        return NULL;
+    }
+
+    event_loop->event_size = 0;
+    INIT_LIST_HEAD(&event_loop->event_head);
+    INIT_LIST_HEAD(&event_loop->event_unused);
+    INIT_LIST_HEAD(&event_loop->output_dirty);
+    (void)sigemptyset(&event_loop->event_sigset);
+    event_loop->event_current = NULL;
+    event_loop->epoll_fd = -1;
+    event_loop->uring.fd = -1;
+    event_loop->backend = &event_backend_epoll;
+    event_loop->changes_size = 0;
+    INIT_LIST_HEAD(&event_loop->report_pending);
+    INIT_LIST_HEAD(&event_loop->buffer_wait);
+    event_loop->event_ps_signal = NULL;
+    event_loop->ps_hooks.head = RB_ROOT;
+    event_loop->ps_hooks.size = 0;
+    event_loop->epoll_get_cnt = 0;
+    event_loop->epoll_ready_cnt = 0;
+    event_loop->busy_poll_usec = 0;
+    event_loop->time_now = event_loop_clock();
+    event_timer_wheel_init(&event_loop->timer_wheel, event_loop->time_now);
+    INIT_LIST_HEAD(&event_loop->timer_pending);
+    event_loop->timer_engine = EVENT_TIMER_WHEEL;
+    event_loop->timer_tree.root = RB_ROOT_CACHED;
+    event_loop->timer_tree.size = 0;
+    event_loop->timer_slack = 0;
+#ifndef EVENT_LOOP_FIXED
+    event_loop->fixed_map = NULL;
+    event_loop->fixed_size = 0;
+    (void)memset(&event_loop->scratch, 0, sizeof(event_loop->scratch));
+    slab_init(&event_loop->event_slab, sizeof(event_type_t), 0);
+    slab_init(&event_loop->hook_slab, sizeof(struct event_ps_hook_s), 0);
+    slab_init(&event_loop->sigset_slab, sizeof(sigset_t), 0);
+    slab_init(&event_loop->stream_slab, sizeof(struct event_stream_s), 0);
+    slab_init(&event_loop->segment_slab, EVENT_OUTPUT_SEGMENT_SIZE, 0);
+    slab_init(&event_loop->buffer_slab, EVENT_INPUT_BUFFER_SIZE, 0);
+    slab_set_chunk_count(&event_loop->buffer_slab, EVENT_INPUT_BUFFER_CHUNK);
+    event_loop->epoll_events = NULL;
+    event_loop->epoll_events_size = 0;
+    event_loop->epoll_events_idle = 0;
+    event_loop->fd_table = NULL;
+    event_loop->fd_table_size = 0;
+    event_loop->handle_table = NULL;
+    event_loop->handle_table_size = 0;
+    event_loop->handle_free = UINT32_MAX;
+    if (event_loop_resize_events(event_loop, EVENT_LOOP_EVENTS_MIN) != 0
+            || event_loop_reserve_fd(event_loop, EVENT_LOOP_FD_TABLE_MIN - 1) != 0
+            || event_loop_grow_handles(event_loop) != 0) {
+        event_loop_release(event_loop);
+        return NULL;
+    }
+#endif
+
+    if (event_loop->backend->init(event_loop) != 0) {
+        event_loop_release(event_loop);
+        event_loop = NULL;
+    }
+
+    return event_loop;
+}
+
+void *event_loop_scratch_alloc(event_loop_t *event_loop, size_t size)
+{
+    void *mem;
+    struct event_scratch_s *scratch;
+#ifndef EVENT_LOOP_FIXED
+    struct event_scratch_chunk_s *chunk;
+#endif
+
+    if (event_loop == NULL || size > SIZE_MAX - EVENT_LOOP_SCRATCH_ALIGN) {
+        return NULL;
+    }
+
+    scratch = &event_loop->scratch;
+    size = (size + EVENT_LOOP_SCRATCH_ALIGN - 1) & ~((size_t)EVENT_LOOP_SCRATCH_ALIGN - 1);
+    scratch->peak += size;
+#ifndef EVENT_LOOP_FIXED
+    if (scratch->base == NULL && size <= EVENT_LOOP_SCRATCH_MIN) {
+        scratch->base = (char *)malloc(EVENT_LOOP_SCRATCH_MIN);
+        scratch->size = scratch->base == NULL ? 0 : EVENT_LOOP_SCRATCH_MIN;
+    }
+#endif
+
+    if (size <= scratch->size - scratch->used) {
+        mem = scratch->base + scratch->used;
+        scratch->used += size;
+        return mem;
+    }
+
+#ifdef EVENT_LOOP_FIXED
+    /* the mapped block is all there is */
+    return NULL;
+#else
+    /* the header is padded so the memory after it keeps the alignment */
+    chunk = (struct event_scratch_chunk_s *)malloc(EVENT_LOOP_SCRATCH_ALIGN + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->next = scratch->overflow;
+    scratch->overflow = chunk;
+
+    return (char *)chunk + EVENT_LOOP_SCRATCH_ALIGN;
+#endif
+}
+
+#ifdef EVENT_LOOP_FIXED
+static void event_loop_scratch_reset(event_loop_t *event_loop)
+{
+    event_loop->scratch.used = 0;
+    event_loop->scratch.peak = 0;
+}
+#else
+static void event_loop_scratch_reset(event_loop_t *event_loop)
+{
+    size_t size;
+    char *base;
+    struct event_scratch_s *scratch;
+    struct event_scratch_chunk_s *chunk;
+
+    scratch = &event_loop->scratch;
+    if (scratch->overflow != NULL) {
+        while ((chunk = scratch->overflow) != NULL) {
+            scratch->overflow = chunk->next;
+            free(chunk);
+        }
+
+        /* make the next batch as busy as this one fit in a single block */
+        size = scratch->size == 0 ? EVENT_LOOP_SCRATCH_MIN : scratch->size;
+        while (size < scratch->peak && size < EVENT_LOOP_SCRATCH_MAX) {
+            size <<= 1;
+        }
+
+        if (size != scratch->size) {
+            base = (char *)malloc(size);
+            if (base != NULL) {
+                free(scratch->base);
+                scratch->base = base;
+                scratch->size = size;
+            }
+        }
+    }
+
+    scratch->used = 0;
+    scratch->peak = 0;
+}
+#endif
+
+static void event_loop_remove_unused_event(event_type_t *event)
+{
+    list_del_init(&event->node);
+    if (!(event->flag & EVENT_F_EXTERNAL)) {
+        slab_free(&event->loop->event_slab, event);
+    }
+}
+
+void event_loop_destroy(event_loop_t *event_loop)
+{
+    event_type_t *event;
+    event_type_t *tmp;
+
+    if (event_loop == NULL) {
+        return;
+    }
+
+    event_loop->event_current = NULL;
+    list_splice_tail_init(&event_loop->report_pending, &event_loop->event_head);
+    list_splice_tail_init(&event_loop->buffer_wait, &event_loop->event_head);
+    list_for_each_entry_safe(event, tmp, &event_loop->event_head, node) {
+        event_loop_cancel(event);
+    }
+
+    list_for_each_entry_safe(event, tmp, &event_loop->event_unused, node) {
+        event_loop_remove_unused_event(event);
+    }
+
+    event_loop->backend->fini(event_loop);
+    event_loop_scratch_reset(event_loop);
+    event_loop_release(event_loop);
+}
+
+static void event_setup(event_type_t *event, enum event_type_e type,
+        event_func_t handler, const char *name, void *arg, int fd)
+{
+    (void)memset(event, 0, sizeof(event_type_t));
+    INIT_LIST_HEAD(&event->node);
+    INIT_LIST_HEAD(&event->timer.node);
+    RB_CLEAR_NODE(&event->timer.rb);
+    event->type = type;
+    event->handler = handler;
+    event->arg = arg;
+    event->fd = fd;
+    if (name != NULL) {
+        strncpy(event->name, name, sizeof(event->name) - 1);
+    }
+}
+
+static event_type_t *event_malloc(event_loop_t *event_loop, enum event_type_e type,
+        event_func_t handler, const char *name, void *arg, int fd)
+{
+    event_type_t *event;
+
+    event = (event_type_t *)slab_alloc(&event_loop->event_slab);
+    if (event == NULL) {
+        return NULL;
+    }
+
+    event_setup(event, type, handler, name, arg, fd);
+    if (event_loop_add_event(event_loop, event) != 0) {
+        slab_free(&event_loop->event_slab, event);
+        event = NULL;
+    }
+
+    return event;
+}
+
+int event_loop_event_init(event_type_t *event, enum event_type_e type,
+        event_func_t handler, const char *name, void *arg, int fd)
+{
+    if (event == NULL || handler == NULL) {
+        return -1;
+    }
+
+    switch (type) {
+    case EVENT_TYPE_READ:
+    case EVENT_TYPE_WRITE:
+        if (fd < 0) {
+            return -1;
+        }
+        break;
+    case EVENT_TYPE_TIMER:
+        fd = -1;
+        break;
+    default:
+        /* signal and linux events own resources only the loop can create */
+        return -1;
+    }
+
+    event_setup(event, type, handler, name, arg, fd);
+    /* stopped until event_loop_event_start() */
+    event->flag = EVENT_F_EXTERNAL | EVENT_F_CANCEL;
+    if (type == EVENT_TYPE_TIMER) {
+        event->flag |= EVENT_F_ONESHOT;
+    }
+
+    return 0;
+}
+
+int event_loop_event_start(event_loop_t *event_loop, event_type_t *event)
+{
+    if (event_loop == NULL || event == NULL || !(event->flag & EVENT_F_EXTERNAL)
+            || !(event->flag & EVENT_F_CANCEL)) {
+        return -1;
+    }
+
+    /* stopped by its own handler and still parked on event_unused */
+    if (!list_empty(&event->node)) {
+        list_del_init(&event->node);
+    }
+
+    event->flag &= ~(EVENT_F_CANCEL | EVENT_F_PENDING | EVENT_F_EXPIRED);
+    if (event->type == EVENT_TYPE_TIMER) {
+        event->timer.slack = event_loop->timer_slack;
+    }
+
+    if (event_loop_add_event(event_loop, event) != 0) {
+        event->flag |= EVENT_F_CANCEL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void event_loop_event_stop(event_type_t *event)
+{
+    if (event != NULL && (event->flag & EVENT_F_EXTERNAL)) {
+        event_loop_cancel(event);
+    }
+}
+
+event_type_t *event_loop_create_read(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, int fd)
+{
+    if (event_loop == NULL || handler == NULL || fd < 0) {
+        return NULL;
+    }
+
+    return event_malloc(event_loop, EVENT_TYPE_READ, handler, name, arg, fd);
+}
+
+event_type_t *event_loop_create_write(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, int fd)
+{
+    if (event_loop == NULL || handler == NULL || fd < 0) {
+        return NULL;
+    }
+
+    return event_malloc(event_loop, EVENT_TYPE_WRITE, handler, name, arg, fd);
+}
+
+event_type_t *event_loop_create_timer(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, time_t time)
+{
+    struct timespec t;
+
+    t.tv_sec = time;
+    t.tv_nsec = 0;
+
+    return event_loop_create_timer_timespec(event_loop, handler, name, arg, t);
+}
+
+event_type_t *event_loop_create_timer_timespec(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, struct timespec time)
+{
+    struct itimerspec t;
+
+    t.it_interval.tv_sec = 0;
+    t.it_interval.tv_nsec = 0;
+    t.it_value.tv_sec = time.tv_sec;
+    t.it_value.tv_nsec = time.tv_nsec;
+    if (t.it_value.tv_nsec == 0 && t.it_value.tv_sec == 0) {
+        t.it_value.tv_nsec = 1;
+    }
+
+    return event_loop_create_loop_timer_itimerspec(event_loop, handler, name, arg, t);
+}
+
+event_type_t *event_loop_create_loop_timer(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, time_t time)
+{
+    struct itimerspec t;
+
+    if (time == 0) {
+        return NULL;
+    }
+
+    t.it_interval.tv_sec = time;
+    t.it_interval.tv_nsec = 0;
+    t.it_value.tv_sec = time;
+    t.it_value.tv_nsec = 0;
+
+    return event_loop_create_loop_timer_itimerspec(event_loop, handler, name, arg, t);
+}
+
+event_type_t *event_loop_create_loop_timer_itimerspec(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, struct itimerspec time)
+{
+    uint64_t value;
+    event_type_t *event;
+
+    if (event_loop == NULL || handler == NULL) {
+        return NULL;
+    }
+
+    event = event_malloc(event_loop, EVENT_TYPE_TIMER, handler, name, arg, -1);
+    if (event == NULL) {
+        return NULL;
+    }
+
+    event->timer.slack = event_loop->timer_slack;
+    event->timer.interval = event_timespec_to_nsec(&time.it_interval);
+    if (event->timer.interval == 0) {
+        event->flag |= EVENT_F_ONESHOT;
+    }
+
+    /* a zero it_value leaves the timer disarmed, as timerfd_settime does */
+    value = event_timespec_to_nsec(&time.it_value);
+    if (value != 0) {
+        event_timer_arm(event_loop, event, event_loop->time_now + value);
+    }
+
+    return event;
+}
+
+/* re-arm in place, no syscall is involved with either timer engine */
+event_type_t *event_loop_alter_timer(event_type_t *event, struct timespec time)
+{
+    uint64_t value;
+
+    if (event == NULL || event->type != EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    value = event_timespec_to_nsec(&time);
+    if (value == 0) {
+        value = 1;
+    }
+
+    event_timer_disarm(event->loop, event);
+    if (event->timer.interval != 0) {
+        event->timer.interval = value;
+    }
+
+    event_timer_arm(event->loop, event, event->loop->time_now + value);
+
+    return event;
+}
+
+event_type_t *event_loop_alter_timer_itimerspec(event_type_t *event, struct itimerspec time)
+{
+    uint64_t value;
+
+    if (event == NULL || event->type != EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    event_timer_disarm(event->loop, event);
+    event->timer.interval = event_timespec_to_nsec(&time.it_interval);
+    if (event->timer.interval == 0) {
+        event->flag |= EVENT_F_ONESHOT;
+    } else {
+        event->flag &= ~EVENT_F_ONESHOT;
+    }
+
+    value = event_timespec_to_nsec(&time.it_value);
+    if (value != 0) {
+        event_timer_arm(event->loop, event, event->loop->time_now + value);
+    }
+
+    return event;
+}
+
+/* takes effect from the next time the timer is armed */
+event_type_t *event_loop_alter_timer_slack(event_type_t *event, struct timespec slack)
+{
+    if (event == NULL || event->type != EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    event->timer.slack = event_timespec_to_nsec(&slack);
+
+    return event;
+}
+
+int event_loop_set_timer_slack(event_loop_t *event_loop, struct timespec slack)
+{
+    if (event_loop == NULL) {
+        return -1;
+    }
+
+    event_loop->timer_slack = event_timespec_to_nsec(&slack);
+
+    return 0;
+}
+
+event_type_t *event_loop_alter_idle_timeout(event_type_t *event, struct timespec timeout,
+        event_func_t handler)
+{
+    event_loop_t *event_loop;
+
+    if (event == NULL || event->type != EVENT_TYPE_READ || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    event_loop = event->loop;
+    event_timer_disarm(event_loop, event);
+    event->timer.interval = event_timespec_to_nsec(&timeout);
+    event->timer.handler = handler;
+    if (event->timer.interval == 0 || handler == NULL) {
+        event->timer.interval = 0;
+        return event;
+    }
+
+    event->timer.slack = event_loop->timer_slack;
+    event->touched = event_loop->time_now;
+    event_timer_arm(event_loop, event, event->touched + event->timer.interval);
+
+    return event;
+}
+
+event_type_t *event_loop_alter_trigger(event_type_t *event, enum event_trigger_e trigger)
+{
+    int flag;
+
+    if (event == NULL || event->type == EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    switch (trigger) {
+    case EVENT_TRIGGER_EDGE:
+        flag = 0;
+        break;
+    case EVENT_TRIGGER_LEVEL:
+        flag = EVENT_F_LEVEL;
+        break;
+    case EVENT_TRIGGER_ONESHOT:
+        flag = EVENT_F_ARM_ONCE;
+        break;
+    case EVENT_TRIGGER_EXCLUSIVE:
+        flag = EVENT_F_EXCLUSIVE;
+        break;
+    default:
+        return NULL;
+    }
+
+    /* EPOLLEXCLUSIVE can only be given when the fd is added */
+    if (((event->flag ^ flag) & EVENT_F_EXCLUSIVE) && (event->flag & EVENT_F_ACTIVE)) {
+        (void)event->loop->backend->del(event->loop, event->fd, event->handle);
+        event->flag &= ~EVENT_F_ACTIVE;
+    }
+
+    event->flag = (event->flag & ~(EVENT_F_TRIGGER | EVENT_F_DISARMED)) | flag;
+    event_loop_modify_event(event->loop, event);
+
+    return event;
+}
+
+int event_loop_event_rearm(event_type_t *event)
+{
+    if (event == NULL || !(event->flag & EVENT_F_ARM_ONCE) || (event->flag & EVENT_F_CANCEL)) {
+        return -1;
+    }
+
+    if (event->flag & EVENT_F_DISARMED) {
+        event->flag &= ~EVENT_F_DISARMED;
+        event_loop_modify_event(event->loop, event);
+    }
+
+    return 0;
+}
+
+int event_loop_event_pause(event_type_t *event)
+{
+    if (event == NULL || event->type == EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return -1;
+    }
+
+    event->flag |= EVENT_F_PAUSED;
+
+    return 0;
+}
+
+int event_loop_event_resume(event_type_t *event)
+{
+    if (event == NULL || event->type == EVENT_TYPE_TIMER || (event->flag & EVENT_F_CANCEL)) {
+        return -1;
+    }
+
+    if (!(event->flag & EVENT_F_PAUSED)) {
+        return 0;
+    }
+
+    /* the modify polls the fd again, whatever was dropped is reported anew */
+    event->flag &= ~EVENT_F_PAUSED;
+    if (event->flag & EVENT_F_MUTED) {
+        event->flag &= ~EVENT_F_MUTED;
+        event_loop_modify_event(event->loop, event);
+    }
+
+    /* the fd may have nothing new for data that is already buffered */
+    if ((event->flag & EVENT_F_BUFFERED) && event->stream->input.tail != event->stream->input.head
+            && event != event->loop->event_current) {
+        event->revents = EPOLLIN;
+        list_move_tail(&event->node, &event->loop->report_pending);
+    }
+
+    return 0;
+}
+
+/* a report for a paused event is dropped and its input interest with it */
+static int event_loop_mute_event(event_loop_t *event_loop, event_type_t *event)
+{
+    event->flag &= ~EVENT_F_DISARMED;
+    /* write events have no input interest to drop */
+    if (!(event->flag & EVENT_F_MUTED) && event->type != EVENT_TYPE_WRITE) {
+        event->flag |= EVENT_F_MUTED;
+        event_loop_modify_event(event_loop, event);
+    }
+
+    return 0;
+}
+
+static void event_output_free_segment(event_loop_t *event_loop,
+        struct event_output_segment_s *segment)
+{
+    list_del(&segment->node);
+    if (segment->release != NULL) {
+        segment->release(segment->ctx);
+    }
+
+    slab_free(&event_loop->segment_slab, segment);
+}
+
+static void event_output_discard(event_loop_t *event_loop, struct event_output_s *output)
+{
+    struct event_output_segment_s *segment;
+    struct event_output_segment_s *tmp;
+
+    list_for_each_entry_safe(segment, tmp, &output->segments, node) {
+        event_output_free_segment(event_loop, segment);
+    }
+
+    list_del_init(&output->dirty);
+    output->bytes = 0;
+}
+
+static struct event_stream_s *event_stream_get(event_type_t *event)
+{
+    struct event_stream_s *stream;
+
+    if (event == NULL || (event->type != EVENT_TYPE_READ && event->type != EVENT_TYPE_WRITE)
+            || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    stream = event->stream;
+    if (stream == NULL) {
+        stream = (struct event_stream_s *)slab_alloc(&event->loop->stream_slab);
+        if (stream == NULL) {
+            return NULL;
+        }
+
+        (void)memset(stream, 0, sizeof(struct event_stream_s));
+        stream->event = event;
+        INIT_LIST_HEAD(&stream->output.segments);
+        INIT_LIST_HEAD(&stream->output.dirty);
+        event->stream = stream;
+    }
+
+    return stream;
+}
+
+/* hand the ring storage back, to the pool if it came from there */
+static void event_input_release(event_loop_t *event_loop, struct event_input_s *input)
+{
+    event_type_t *waiter;
+
+#ifndef EVENT_LOOP_FIXED
+    /* only a ring grown past one pool buffer came from malloc */
+    if (input->size > EVENT_INPUT_BUFFER_SIZE) {
+        free(input->data);
+    }
+#endif
+    if (input->size == EVENT_INPUT_BUFFER_SIZE) {
+        slab_free(&event_loop->buffer_slab, input->data);
+        /* the data of the first event left waiting is still in the kernel */
+        if (!list_empty(&event_loop->buffer_wait)) {
+            waiter = list_first_entry(&event_loop->buffer_wait, event_type_t, node);
+            waiter->revents = EPOLLIN;
+            list_move_tail(&waiter->node, &event_loop->report_pending);
+        }
+    }
+
+    input->data = NULL;
+    input->size = 0;
+    input->head = 0;
+    input->tail = 0;
+}
+
+/* called on cancel, whatever was not written or consumed is lost */
+static void event_stream_drop(event_loop_t *event_loop, event_type_t *event)
+{
+    if (event->stream != NULL) {
+        event_output_discard(event_loop, &event->stream->output);
+        event_input_release(event_loop, &event->stream->input);
+        slab_free(&event_loop->stream_slab, event->stream);
+        event->stream = NULL;
+    }
+}
+
+static struct event_output_s *event_output_prepare(event_type_t *event)
+{
+    struct event_stream_s *stream;
+
+    stream = event_stream_get(event);
+    if (stream == NULL || stream->output.error != 0) {
+        return NULL;
+    }
+
+    return &stream->output;
+}
 
-    result = (((fd + 1) >> (EVENT_LOOP_MAX_SHIFT_BITS)) + 1) << (EVENT_LOOP_MAX_SHIFT_BITS);
-    if (result < 0) {
-        result = INT_MAX;
+/* a blocked output is written when EPOLLOUT comes, the others at the batch end */
+static void event_output_mark(event_loop_t *event_loop, struct event_output_s *output)
+{
+    if (!output->blocked && list_empty(&output->dirty)) {
+        list_add_tail(&output->dirty, &event_loop->output_dirty);
     }
-
-    return result;
 }
 
-static int event_loop_reinit(event_loop_t *event_loop, int newfd)
+/*
+ * writev as much of the queue as the kernel takes, a short write means its
+ * buffer is full and EPOLLOUT is armed until the rest can go out
+ */
+static int event_output_flush(event_loop_t *event_loop, event_type_t *event)
 {
-    int epoll_fd;
-    int epoll_volume;
-    struct epoll_event *epoll_events;
+    int cnt;
+    int ret;
+    int blocked;
+    ssize_t done;
+    size_t size;
+    struct iovec iov[IOV_MAX];
+    struct event_output_s *output;
+    struct event_output_segment_s *segment;
+    struct event_output_segment_s *tmp;
+
+    if (event->stream == NULL) {
+        return 0;
+    }
+
+    output = &event->stream->output;
+    list_del_init(&output->dirty);
+    ret = 0;
+    blocked = 0;
+    while (output->bytes != 0) {
+        cnt = 0;
+        size = 0;
+        list_for_each_entry(segment, &output->segments, node) {
+            if (cnt == IOV_MAX) {
+                break;
+            }
 
-    if (newfd < event_loop->epoll_volume) {
-        if (newfd > event_loop->epoll_fd_max) {
-            event_loop->epoll_fd_max = newfd;
+            iov[cnt].iov_base = (void *)segment->base;
+            iov[cnt].iov_len = segment->len;
+            size += segment->len;
+            ++cnt;
         }
 
-        return 0;
+        done = writev(event->fd, iov, cnt);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                blocked = 1;
+                break;
+            }
+
+            output->error = errno;
+            event_output_discard(event_loop, output);
+            ret = -1;
+            break;
+        }
+
+        output->bytes -= done;
+        blocked = (size_t)done < size;
+        list_for_each_entry_safe(segment, tmp, &output->segments, node) {
+            if ((size_t)done < segment->len) {
+                segment->base += done;
+                segment->len -= done;
+                break;
+            }
+
+            done -= segment->len;
+            event_output_free_segment(event_loop, segment);
+        }
+
+        if (blocked) {
+            break;
+        }
     }
 
-    epoll_volume = event_loop_count_epoll_size(newfd);
-    epoll_events = (struct epoll_event *)malloc(sizeof(struct epoll_event) * epoll_volume);
-    if (epoll_events == NULL) {
-        return -1;
+    /* a oneshot report used up the EPOLLOUT poll as well */
+    if (blocked != output->blocked || (blocked && (event->flag & EVENT_F_DISARMED))) {
+        output->blocked = blocked;
+        event_loop_modify_event(event_loop, event);
     }
 
-    epoll_fd = epoll_create(epoll_volume);
-    if (epoll_fd < 0) {
-        free(epoll_events);
+    return ret;
+}
+
+int event_loop_write(event_type_t *event, const void *buf, size_t len)
+{
+    size_t room;
+    size_t copy;
+    size_t need;
+    const char *src;
+    struct list_head fresh;
+    struct event_output_s *output;
+    struct event_output_segment_s *segment;
+    struct event_output_segment_s *tmp;
+
+    output = event_output_prepare(event);
+    if (output == NULL || (buf == NULL && len != 0)) {
         return -1;
     }
 
-    if (event_loop->epoll_fd >= 0) {
-        (void)close(event_loop->epoll_fd);
+    /* fill the inline space left in the last segment first */
+    room = 0;
+    segment = NULL;
+    if (!list_empty(&output->segments)) {
+        segment = list_entry(output->segments.prev, struct event_output_segment_s, node);
+        if (segment->release == NULL) {
+            room = EVENT_OUTPUT_INLINE_SIZE - segment->fill;
+        }
+    }
+
+    /* take every segment up front so that a failure queues nothing */
+    INIT_LIST_HEAD(&fresh);
+    for (need = len > room ? len - room : 0; need != 0; need -= copy) {
+        tmp = (struct event_output_segment_s *)slab_alloc(&event->loop->segment_slab);
+        if (tmp == NULL) {
+            list_for_each_entry_safe(segment, tmp, &fresh, node) {
+                event_output_free_segment(event->loop, segment);
+            }
+
+            return -1;
+        }
+
+        tmp->base = tmp->data;
+        tmp->len = 0;
+        tmp->release = NULL;
+        tmp->ctx = NULL;
+        tmp->fill = 0;
+        list_add_tail(&tmp->node, &fresh);
+        copy = need < EVENT_OUTPUT_INLINE_SIZE ? need : EVENT_OUTPUT_INLINE_SIZE;
     }
 
-    if (event_loop->epoll_events != NULL) {
-        free(event_loop->epoll_events);
+    src = (const char *)buf;
+    if (room != 0) {
+        copy = len < room ? len : room;
+        (void)memcpy(segment->data + segment->fill, src, copy);
+        segment->fill += copy;
+        segment->len += copy;
+        src += copy;
+        len -= copy;
+        output->bytes += copy;
     }
 
-    if (newfd > event_loop->epoll_fd_max) {
-        event_loop->epoll_fd_max = newfd;
+    list_for_each_entry(segment, &fresh, node) {
+        copy = len < EVENT_OUTPUT_INLINE_SIZE ? len : EVENT_OUTPUT_INLINE_SIZE;
+        (void)memcpy(segment->data, src, copy);
+        segment->fill = copy;
+        segment->len = copy;
+        src += copy;
+        len -= copy;
+        output->bytes += copy;
     }
 
-    event_loop->epoll_fd = epoll_fd;
-    event_loop->epoll_events = epoll_events;
-    event_loop->epoll_volume = epoll_volume;
-    (void)memset(epoll_events, 0, sizeof(struct epoll_event) * epoll_volume);
+    list_splice_tail(&fresh, &output->segments);
+    event_output_mark(event->loop, output);
 
     return 0;
 }
 
-static int event_loop_active_event(event_loop_t *event_loop, event_type_t *event)
+int event_loop_write_ref(event_type_t *event, const void *buf, size_t len,
+        event_free_func_t release, void *ctx)
 {
-    struct epoll_event ev;
+    struct event_output_s *output;
+    struct event_output_segment_s *segment;
 
-    if (event_loop_reinit(event_loop, event->fd) != 0) {
+    output = event_output_prepare(event);
+    if (output == NULL || buf == NULL) {
         return -1;
     }
 
-    ev.data.ptr = event;
-    switch (event->type) {
-    case EVENT_TYPE_READ:
-        ev.events = EPOLLIN | EPOLLET;
-        break;
-    case EVENT_TYPE_WRITE:
-        ev.events = EPOLLOUT | EPOLLET;
-        break;
-    case EVENT_TYPE_TIMER:
-    case EVENT_TYPE_SIGNAL:
-        ev.events = EPOLLIN | EPOLLET;
-        break;
-    case EVENT_TYPE_LINUX_EVENT:
-        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
-        break;
+    segment = (struct event_output_segment_s *)slab_alloc(&event->loop->segment_slab);
+    if (segment == NULL) {
+        return -1;
     }
 
-    return epoll_ctl(event_loop->epoll_fd, EPOLL_CTL_ADD, event->fd, &ev);
+    segment->base = (const char *)buf;
+    segment->len = len;
+    segment->release = release;
+    segment->ctx = ctx;
+    segment->fill = 0;
+    list_add_tail(&segment->node, &output->segments);
+    output->bytes += len;
+    event_output_mark(event->loop, output);
+
+    return 0;
 }
 
-static int event_loop_add_event(event_loop_t *event_loop, event_type_t *event)
+int event_loop_flush(event_type_t *event)
 {
-    int ret;
-
-    ret = event_loop_active_event(event_loop, event);
-    if (ret == 0) {
-        ++event_loop->event_size;
-        event->loop = event_loop;
-        list_add_tail(&event->node, &event_loop->event_head);
+    if (event_output_prepare(event) == NULL) {
+        return -1;
     }
 
-    return ret;
+    return event_output_flush(event->loop, event);
 }
 
-event_loop_t *event_loop_create(void)
+event_type_t *event_loop_alter_read_buffer(event_type_t *event, size_t limit)
 {
-    event_loop_t *event_loop;
+    size_t size;
+    struct event_stream_s *stream;
 
-    event_loop = (event_loop_t *)malloc(sizeof(event_loop_t));
-    if (event_loop == NULL) {
+    if (event == NULL || event->type != EVENT_TYPE_READ) {
         return NULL;
     }
 
-    event_loop->event_size = 0;
-    INIT_LIST_HEAD(&event_loop->event_head);
-    INIT_LIST_HEAD(&event_loop->event_unused);
-    (void)sigemptyset(&event_loop->event_sigset);
-    event_loop->event_current = NULL;
-    event_loop->epoll_fd = -1;
-    event_loop->epoll_fd_max = -1;
-    event_loop->epoll_volume = -1;
-    event_loop->epoll_events = NULL;
-    event_loop->event_ps_signal = NULL;
-    event_loop->epoll_get_cnt = 0;
-    if (event_loop_reinit(event_loop, 0) != 0) {
-        free(event_loop);
-        event_loop = NULL;
+    stream = event_stream_get(event);
+    if (stream == NULL) {
+        return NULL;
     }
 
-    return event_loop;
-}
-
-void event_loop_destroy(event_loop_t *event_loop)
-{
-    event_type_t *event;
-    event_type_t *tmp;
+    if (limit == 0) {
+        event_input_release(event->loop, &stream->input);
+        (void)memset(&stream->input, 0, sizeof(struct event_input_s));
+        event->flag &= ~EVENT_F_BUFFERED;
+        return event;
+    }
 
-    if (event_loop == NULL) {
-        return;
+#ifdef EVENT_LOOP_FIXED
+    /* growing past a pool buffer would need malloc */
+    if (limit > EVENT_INPUT_BUFFER_SIZE) {
+        limit = EVENT_INPUT_BUFFER_SIZE;
+    }
+#endif
+    /* round up to a power of two so that positions are masked, never divided */
+    for (size = EVENT_INPUT_BUFFER_SIZE; size < limit && size <= (SIZE_MAX >> 1); size <<= 1) {
     }
 
-    event_loop->event_current = NULL;
-    list_for_each_entry_safe(event, tmp, &event_loop->event_head, node) {
-        event_loop_cancel(event);
+    if (size < stream->input.size) {
+        return NULL;
     }
 
-    if (event_loop->epoll_fd >= 0) {
-        (void)close(event_loop->epoll_fd);
+    stream->input.limit = size;
+    event->flag |= EVENT_F_BUFFERED;
+
+    return event;
+}
+
+#ifdef EVENT_LOOP_FIXED
+/* limits are capped at one pool buffer, an empty ring borrows it and that is all */
+static int event_input_grow(event_loop_t *event_loop, struct event_input_s *input)
+{
+    if (input->limit == 0 || input->size != 0) {
+        return -1;
     }
 
-    if (event_loop->epoll_events != NULL) {
-        free(event_loop->epoll_events);
+    input->data = (char *)slab_alloc(&event_loop->buffer_slab);
+    if (input->data == NULL) {
+        return -1;
     }
 
-    free(event_loop);
-}
+    input->size = EVENT_INPUT_BUFFER_SIZE;
+    input->head = 0;
+    input->tail = 0;
 
-static event_type_t *event_malloc(event_loop_t *event_loop, enum event_type_e type,
-        event_func_t handler, const char *name, void *arg, int fd)
+    return 0;
+}
+#else
+/*
+ * borrow a pool buffer for an empty ring, else double it and unwrap its
+ * content to the start of the new one
+ */
+static int event_input_grow(event_loop_t *event_loop, struct event_input_s *input)
 {
-    event_type_t *event;
+    char *data;
+    size_t size;
+    size_t used;
+    size_t off;
+    size_t first;
+
+    /* not in buffered mode */
+    if (input->limit == 0) {
+        return -1;
+    }
 
-    event = (event_type_t *)malloc(sizeof(event_type_t));
-    if (event == NULL) {
-        return NULL;
+    if (input->size == 0) {
+        input->data = (char *)slab_alloc(&event_loop->buffer_slab);
+        if (input->data == NULL) {
+            return -1;
+        }
+
+        input->size = EVENT_INPUT_BUFFER_SIZE;
+        input->head = 0;
+        input->tail = 0;
+        return 0;
     }
 
-    (void)memset(event, 0, sizeof(event_type_t));
-    event->type = type;
-    event->handler = handler;
-    event->arg = arg;
-    event->fd = fd;
-    if (name != NULL) {
-        strncpy(event->name, name, sizeof(event->name) - 1);
+    size = input->size << 1;
+    if (size > input->limit) {
+        return -1;
     }
 
-    if (event_loop_add_event(event_loop, event) != 0) {
-        free(event);
-        event = NULL;
+    data = (char *)malloc(size);
+    if (data == NULL) {
+        return -1;
     }
 
-    return event;
-}
+    used = input->tail - input->head;
+    if (used != 0) {
+        off = input->head & (input->size - 1);
+        first = input->size - off < used ? input->size - off : used;
+        (void)memcpy(data, input->data + off, first);
+        (void)memcpy(data + first, input->data, used - first);
+    }
 
-event_type_t *event_loop_create_read(event_loop_t *event_loop,
-        event_func_t handler, const char *name, void *arg, int fd)
+    event_input_release(event_loop, input);
+    input->data = data;
+    input->size = size;
+    input->tail = used;
+
+    return 0;
+}
+#endif
+
+/*
+ * readv into the free part of the ring, at most two segments, until the fd
+ * is drained. Return 1 when it stopped on a full ring with data left, -1
+ * when the pool had no buffer to lend.
+ */
+static int event_input_fill(event_loop_t *event_loop, event_type_t *event,
+        struct event_input_s *input)
 {
-    if (event_loop == NULL || handler == NULL || fd < 0) {
-        return NULL;
+    int cnt;
+    ssize_t ret;
+    size_t off;
+    size_t space;
+    struct iovec iov[2];
+
+    while (!input->eof && !input->error) {
+        space = input->size - (input->tail - input->head);
+        if (space == 0) {
+            if (event_input_grow(event_loop, input) != 0) {
+                return input->size != 0 ? 1 : -1;
+            }
+
+            space = input->size - (input->tail - input->head);
+        }
+
+        off = input->tail & (input->size - 1);
+        iov[0].iov_base = input->data + off;
+        if (input->size - off >= space) {
+            iov[0].iov_len = space;
+            cnt = 1;
+        } else {
+            iov[0].iov_len = input->size - off;
+            iov[1].iov_base = input->data;
+            iov[1].iov_len = space - iov[0].iov_len;
+            cnt = 2;
+        }
+
+        ret = readv(event->fd, iov, cnt);
+        if (ret > 0) {
+            input->tail += ret;
+            /* a stream hands over all it has, a short read means it is drained */
+            if ((size_t)ret < space) {
+                /* the peer had shut down before the report, this was the last of it */
+                if (event->revents & EPOLLRDHUP) {
+                    input->eof = 1;
+                }
+                break;
+            }
+        } else if (ret == 0) {
+            input->eof = 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            input->error = errno;
+        }
     }
 
-    return event_malloc(event_loop, EVENT_TYPE_READ, handler, name, arg, fd);
+    return 0;
 }
 
-event_type_t *event_loop_create_timer(event_loop_t *event_loop,
-        event_func_t handler, const char *name, void *arg, time_t time)
+static int event_input_dispatch(event_loop_t *event_loop, event_type_t *event)
 {
-    struct timespec t;
+    int ret;
+    int full;
+    size_t held;
+    struct event_input_s *input;
+
+    ret = 0;
+    input = &event->stream->input;
+    while (1) {
+        full = event_input_fill(event_loop, event, input);
+        /* under EPOLLET nothing reports the fd again, the next returned buffer does */
+        if (full < 0) {
+            list_move_tail(&event->node, &event_loop->buffer_wait);
+            break;
+        }
 
-    t.tv_sec = time;
-    t.tv_nsec = 0;
+        if (input->tail == input->head) {
+            /* nothing held, the buffer goes back to the pool */
+            if (input->size != 0) {
+                event_input_release(event_loop, input);
+            }
 
-    return event_loop_create_timer_timespec(event_loop, handler, name, arg, t);
-}
+            if (!input->eof && !input->error) {
+                break;
+            }
+        }
 
-event_type_t *event_loop_create_timer_timespec(event_loop_t *event_loop,
-        event_func_t handler, const char *name, void *arg, struct timespec time)
-{
-    struct itimerspec t;
+        /* consuming everything releases the ring and resets head, so count bytes held */
+        held = input->tail - input->head;
+        ret = event->handler(event);
+        if (event->flag & (EVENT_F_CANCEL | EVENT_F_PAUSED)) {
+            break;
+        }
 
-    t.it_interval.tv_sec = 0;
-    t.it_interval.tv_nsec = 0;
-    t.it_value.tv_sec = time.tv_sec;
-    t.it_value.tv_nsec = time.tv_nsec;
-    if (t.it_value.tv_nsec == 0 && t.it_value.tv_sec == 0) {
-        t.it_value.tv_nsec = 1;
+        /* the handler left buffered mode, an undrained fd is its to read now */
+        if (!(event->flag & EVENT_F_BUFFERED)) {
+            if (full) {
+                event->revents = EPOLLIN;
+                list_move_tail(&event->node, &event_loop->report_pending);
+            }
+            break;
+        }
+
+        /* give the handler another go only if it made room in a full ring */
+        if (!full || input->tail - input->head == held) {
+            break;
+        }
     }
 
-    return event_loop_create_loop_timer_itimerspec(event_loop, handler, name, arg, t);
+    return ret;
 }
 
-event_type_t *event_loop_create_loop_timer(event_loop_t *event_loop,
-        event_func_t handler, const char *name, void *arg, time_t time)
+size_t event_loop_input_peek(event_type_t *event, struct iovec iov[2])
 {
-    struct itimerspec t;
+    size_t off;
+    size_t used;
+    struct event_input_s *input;
+
+    iov[0].iov_base = NULL;
+    iov[0].iov_len = 0;
+    iov[1].iov_base = NULL;
+    iov[1].iov_len = 0;
+    if (event == NULL || !(event->flag & EVENT_F_BUFFERED)) {
+        return 0;
+    }
 
-    if (time == 0) {
-        return NULL;
+    input = &event->stream->input;
+    used = input->tail - input->head;
+    if (used == 0) {
+        return 0;
     }
 
-    t.it_interval.tv_sec = time;
-    t.it_interval.tv_nsec = 0;
-    t.it_value.tv_sec = time;
-    t.it_value.tv_nsec = 0;
+    off = input->head & (input->size - 1);
+    iov[0].iov_base = input->data + off;
+    iov[0].iov_len = input->size - off < used ? input->size - off : used;
+    if (iov[0].iov_len != used) {
+        iov[1].iov_base = input->data;
+        iov[1].iov_len = used - iov[0].iov_len;
+    }
 
-    return event_loop_create_loop_timer_itimerspec(event_loop, handler, name, arg, t);
+    return used;
 }
 
-event_type_t *event_loop_create_loop_timer_itimerspec(event_loop_t *event_loop,
-        event_func_t handler, const char *name, void *arg, struct itimerspec time)
+size_t event_loop_input_consume(event_type_t *event, size_t len)
 {
-    int ret;
-    int timerfd;
-    event_type_t *event;
+    size_t used;
+    struct event_input_s *input;
 
-    if (event_loop == NULL || handler == NULL) {
-        return NULL;
+    if (event == NULL || !(event->flag & EVENT_F_BUFFERED)) {
+        return 0;
     }
 
-    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-    if (timerfd < 0) {
-        return NULL;
+    input = &event->stream->input;
+    used = input->tail - input->head;
+    if (len > used) {
+        len = used;
     }
 
-    ret = timerfd_settime(timerfd, 0, &time, NULL);
-    if (ret < 0) {
-        (void)close(timerfd);
-        return NULL;
+    input->head += len;
+    if (input->head == input->tail && input->size != 0) {
+        event_input_release(event->loop, input);
     }
 
-    event = event_malloc(event_loop, EVENT_TYPE_TIMER, handler, name, arg, timerfd);
-    if (event == NULL) {
-        (void)close(timerfd);
-    } else if (time.it_interval.tv_sec == 0 && time.it_interval.tv_nsec == 0) {
-        event->flag |= EVENT_F_ONESHOT;
+    return len;
+}
+
+int event_loop_input_eof(event_type_t *event)
+{
+    if (event == NULL || !(event->flag & EVENT_F_BUFFERED)) {
+        return 0;
     }
 
-    return event;
+    if (event->stream->input.error) {
+        return -1;
+    }
+
+    return event->stream->input.eof;
+}
+
+static void event_loop_flush_outputs(event_loop_t *event_loop)
+{
+    struct event_stream_s *stream;
+
+    while (!list_empty(&event_loop->output_dirty)) {
+        stream = list_first_entry(&event_loop->output_dirty, struct event_stream_s, output.dirty);
+        (void)event_output_flush(event_loop, stream->event);
+    }
 }
 
 static int event_unmask_signal(sigset_t *dst, const sigset_t *set, const sigset_t *unmasked)
@@ -296,43 +2150,96 @@ event_type_t *event_loop_create_signal(event_loop_t *event_loop, event_func_t ha
     int ret;
     int signal_fd;
     sigset_t tmpset;
+    sigset_t *sigset;
     event_type_t *event;
 
     if (event_loop == NULL || handler == NULL || mask == NULL) {
         return NULL;
     }
 
-    ret = event_unmask_signal(&tmpset, &event_loop->event_sigset, mask);
-    if (ret != 0) {
+    /* a signal can only be owned by one event of the loop */
+    ret = sigandset(&tmpset, &event_loop->event_sigset, mask);
+    if (ret != 0 || !sigisemptyset(&tmpset)) {
+        return NULL;
+    }
+
+    /* kept out of the event, only cancel and alter ever look at it */
+    sigset = (sigset_t *)slab_alloc(&event_loop->sigset_slab);
+    if (sigset == NULL) {
+        return NULL;
+    }
+
+    ret = sigprocmask(SIG_BLOCK, mask, NULL);
+    if (ret != 0) {
+        slab_free(&event_loop->sigset_slab, sigset);
+        return NULL;
+    }
+
+    signal_fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        slab_free(&event_loop->sigset_slab, sigset);
+        return NULL;
+    }
+
+    event = event_malloc(event_loop, EVENT_TYPE_SIGNAL, handler, name, arg, signal_fd);
+    if (event == NULL) {
+        (void)close(signal_fd);
+        slab_free(&event_loop->sigset_slab, sigset);
+    } else {
+        (void)memcpy(sigset, mask, sizeof(sigset_t));
+        event->sigset = sigset;
+        ret = sigorset(&event_loop->event_sigset, &event_loop->event_sigset, mask);
+        if (ret != 0) {
+            event_loop_cancel(event);
+            event = NULL;
+        }
+    }
+
+    return event;
+}
+
+event_type_t *event_loop_alter_signal(event_type_t *event, const sigset_t *mask)
+{
+    int ret;
+    sigset_t others;
+    sigset_t added;
+    sigset_t removed;
+    event_loop_t *event_loop;
+
+    if (event == NULL || mask == NULL || event->type != EVENT_TYPE_SIGNAL
+            || (event->flag & EVENT_F_CANCEL)) {
+        return NULL;
+    }
+
+    event_loop = event->loop;
+    if (event_loop->event_ps_signal == event) {
         return NULL;
     }
 
-    ret = memcmp(&tmpset, &event_loop->event_sigset, sizeof(sigset_t));
-    if (ret != 0) {
+    (void)sigemptyset(&others);
+    (void)sigemptyset(&added);
+    (void)sigemptyset(&removed);
+    ret = event_unmask_signal(&others, &event_loop->event_sigset, event->sigset);
+    ret |= sigandset(&added, &others, mask);
+    if (ret != 0 || !sigisemptyset(&added)) {
         return NULL;
     }
 
-    ret = sigprocmask(SIG_BLOCK, mask, NULL);
-    if (ret != 0) {
+    ret = event_unmask_signal(&added, mask, event->sigset);
+    ret |= event_unmask_signal(&removed, event->sigset, mask);
+    if (ret != 0 || sigprocmask(SIG_BLOCK, &added, NULL) != 0) {
         return NULL;
     }
 
-    signal_fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
-    if (signal_fd < 0) {
+    /* swap the mask of the existing signalfd, no new fd or epoll_ctl */
+    if (signalfd(event->fd, mask, 0) < 0) {
+        (void)sigprocmask(SIG_UNBLOCK, &added, NULL);
         return NULL;
     }
 
-    event = event_malloc(event_loop, EVENT_TYPE_SIGNAL, handler, name, arg, signal_fd);
-    if (event == NULL) {
-        (void)close(signal_fd);
-    } else {
-        (void)memcpy(&event->data.sig.set, mask, sizeof(sigset_t));
-        ret = sigorset(&event_loop->event_sigset, &event_loop->event_sigset, mask);
-        if (ret != 0) {
-            event_loop_cancel(event);
-            event = NULL;
-        }
-    }
+    (void)sigprocmask(SIG_UNBLOCK, &removed, NULL);
+    (void)sigorset(&event_loop->event_sigset, &others, mask);
+    (void)memcpy(event->sigset, mask, sizeof(sigset_t));
 
     return event;
 }
@@ -390,7 +2297,7 @@ static int event_loop_process_hook(event_type_t *event)
     ret = ps_hook->handler(status, ps_hook->arg);
     rb_erase(&ps_hook->node, &ps_hook_head->head);
     --ps_hook_head->size;
-    free(ps_hook);
+    slab_free(&event->loop->hook_slab, ps_hook);
 
     return ret;
 }
@@ -399,7 +2306,6 @@ static event_type_t *event_loop_create_signalfd_sigchild(event_loop_t *event_loo
 {
     sigset_t sig;
     event_type_t *event;
-    struct event_ps_hook_head_s *head;
 
     if (event_loop == NULL) {
         return NULL;
@@ -411,19 +2317,12 @@ static event_type_t *event_loop_create_signalfd_sigchild(event_loop_t *event_loo
 
     (void)sigemptyset(&sig);
     (void)sigaddset(&sig, SIGCHLD);
-    head = (struct event_ps_hook_head_s *)malloc(sizeof(*head));
-    if (head == NULL) {
-        return NULL;
-    }
-
-    event = event_loop_create_signal(event_loop, event_loop_process_hook, NULL, (void *)head, &sig);
+    event = event_loop_create_signal(event_loop, event_loop_process_hook, NULL,
+            (void *)&event_loop->ps_hooks, &sig);
     if (event == NULL) {
-        free(head);
         return NULL;
     }
 
-    head->head = RB_ROOT;
-    head->size = 0;
     event_loop->event_ps_signal = event;
 
     return event;
@@ -459,7 +2358,7 @@ static int event_loop_add_ps_hook(event_loop_t *event_loop, const pid_t pid, eve
         }
     }
 
-    hook = (struct event_ps_hook_s *)malloc(sizeof(*hook));
+    hook = (struct event_ps_hook_s *)slab_alloc(&event_loop->hook_slab);
     if (hook == NULL) {
         return -1;
     }
@@ -474,6 +2373,18 @@ static int event_loop_add_ps_hook(event_loop_t *event_loop, const pid_t pid, eve
     return 0;
 }
 
+static void event_loop_free_ps_hooks(event_loop_t *event_loop, struct event_ps_hook_head_s *h)
+{
+    struct rb_node *node;
+
+    while ((node = rb_first(&h->head)) != NULL) {
+        rb_erase(node, &h->head);
+        slab_free(&event_loop->hook_slab, rb_entry(node, struct event_ps_hook_s, node));
+    }
+
+    h->size = 0;
+}
+
 pid_t event_loop_create_process(event_loop_t *event_loop, event_ps_func_t handler,
         void *arg, char *exec_name, char **exec_arg)
 {
@@ -500,146 +2411,438 @@ pid_t event_loop_create_process(event_loop_t *event_loop, event_ps_func_t handle
     return pid;
 }
 
-static void event_loop_remove_unused_event(event_type_t *event)
+int event_loop_set_slab_hugepage(event_loop_t *event_loop, int enable)
 {
-    list_del(&event->node);
-    free(event);
+    int flags;
+
+    if (event_loop == NULL) {
+        return -1;
+    }
+
+    flags = enable ? SLAB_F_HUGEPAGE : 0;
+    event_loop->event_slab.flags = (event_loop->event_slab.flags & SLAB_F_FIXED) | flags;
+    event_loop->hook_slab.flags = (event_loop->hook_slab.flags & SLAB_F_FIXED) | flags;
+    event_loop->sigset_slab.flags = (event_loop->sigset_slab.flags & SLAB_F_FIXED) | flags;
+    event_loop->stream_slab.flags = (event_loop->stream_slab.flags & SLAB_F_FIXED) | flags;
+    event_loop->segment_slab.flags = (event_loop->segment_slab.flags & SLAB_F_FIXED) | flags;
+    event_loop->buffer_slab.flags = (event_loop->buffer_slab.flags & SLAB_F_FIXED) | flags;
+
+    return 0;
+}
+
+int event_loop_slab_stats(event_loop_t *event_loop, struct slab_stats_s *events,
+        struct slab_stats_s *ps_hooks)
+{
+    if (event_loop == NULL) {
+        return -1;
+    }
+
+    if (events != NULL) {
+        slab_stats(&event_loop->event_slab, events);
+    }
+
+    if (ps_hooks != NULL) {
+        slab_stats(&event_loop->hook_slab, ps_hooks);
+    }
+
+    return 0;
+}
+
+int event_loop_buffer_stats(event_loop_t *event_loop, struct slab_stats_s *buffers)
+{
+    if (event_loop == NULL || buffers == NULL) {
+        return -1;
+    }
+
+    slab_stats(&event_loop->buffer_slab, buffers);
+
+    return 0;
 }
 
 void event_loop_cancel(event_type_t *event)
 {
-    if (event == NULL) {
+    if (event == NULL || (event->flag & EVENT_F_CANCEL)) {
         return;
     }
 
     --event->loop->event_size;
     list_del(&event->node);
     list_add_tail(&event->node, &event->loop->event_unused);
-    (void)epoll_ctl(event->loop->epoll_fd, EPOLL_CTL_DEL, event->fd, NULL);
+    if (event->fd >= 0) {
+        event->loop->fd_table[event->fd] = NULL;
+    }
+
     switch (event->type) {
     case EVENT_TYPE_READ:
+        event_timer_disarm(event->loop, event);
     case EVENT_TYPE_WRITE:
+        event_stream_drop(event->loop, event);
+        event_loop_deactive_event(event->loop, event);
+        break;
+    case EVENT_TYPE_TIMER:
+        event_timer_disarm(event->loop, event);
         break;
     case EVENT_TYPE_SIGNAL:
         (void)event_unmask_signal(&event->loop->event_sigset, &event->loop->event_sigset,
-                &event->data.sig.set);
-        (void)sigprocmask(SIG_UNBLOCK, &event->data.sig.set, NULL);
-    case EVENT_TYPE_TIMER:
+                event->sigset);
+        (void)sigprocmask(SIG_UNBLOCK, event->sigset, NULL);
+        slab_free(&event->loop->sigset_slab, event->sigset);
+        event->sigset = NULL;
     case EVENT_TYPE_LINUX_EVENT:
+        event_loop_deactive_event(event->loop, event);
         (void)close(event->fd);
         break;
     }
 
-    if (event->loop->event_current != event) {
+    /* later entries of the current batch no longer resolve to it */
+    event_loop_free_handle(event->loop, event);
+
+    if (event->loop->event_ps_signal == event) {
+        event_loop_free_ps_hooks(event->loop, (struct event_ps_hook_head_s *)event->arg);
+        event->arg = NULL;
+        event->loop->event_ps_signal = NULL;
+    }
+
+    /* the dispatch of the current event still reads it once the handler returns */
+    event->flag |= EVENT_F_CANCEL;
+    if (event != event->loop->event_current) {
         event_loop_remove_unused_event(event);
-    } else {
-        event->flag |= EVENT_F_CANCEL;
     }
 }
 
-event_type_t *event_loop_wait(event_loop_t *event_loop)
+/* events reported by the loop itself lead the next batch */
+static int event_loop_report_pending(event_loop_t *event_loop)
 {
     int cnt;
-    event_type_t *unused;
     event_type_t *event;
+    event_type_t *tmp;
+
+    cnt = 0;
+    list_for_each_entry_safe(event, tmp, &event_loop->report_pending, node) {
+        if (cnt == event_loop->epoll_events_size) {
+            break;
+        }
+
+        event_loop->epoll_events[cnt].data.u64 = event->handle;
+        event_loop->epoll_events[cnt].events = event->revents;
+        list_move_tail(&event->node, &event_loop->event_head);
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+static int event_loop_poll(event_loop_t *event_loop, int timeout)
+{
+    int cnt;
+    int reported;
+    uint64_t spin;
+    uint64_t deadline;
+
+    event_loop_apply_changes(event_loop);
+    reported = event_loop_report_pending(event_loop);
+    if (reported != 0) {
+        cnt = event_loop->backend->wait(event_loop, event_loop->epoll_events + reported,
+                event_loop->epoll_events_size - reported, 0);
+        return cnt > 0 ? reported + cnt : reported;
+    }
+
+    if (event_loop->busy_poll_usec != 0 && timeout != 0) {
+        /* never spin past the next timer */
+        spin = (uint64_t)event_loop->busy_poll_usec * EVENT_NSEC_PER_USEC;
+        if (timeout > 0 && spin > (uint64_t)timeout * EVENT_NSEC_PER_MSEC) {
+            spin = (uint64_t)timeout * EVENT_NSEC_PER_MSEC;
+        }
+
+        deadline = event_loop_clock() + spin;
+        do {
+            cnt = event_loop->backend->wait(event_loop, event_loop->epoll_events,
+                    event_loop->epoll_events_size, 0);
+            if (cnt != 0) {
+                return cnt;
+            }
+        } while (event_loop_clock() < deadline);
+
+        if (timeout > 0) {
+            timeout -= spin / EVENT_NSEC_PER_MSEC;
+        }
+    }
+
+    return event_loop->backend->wait(event_loop, event_loop->epoll_events,
+            event_loop->epoll_events_size, timeout);
+}
 
+int event_loop_set_busy_poll(event_loop_t *event_loop, unsigned int usec)
+{
     if (event_loop == NULL) {
-        return NULL;
+        return -1;
     }
 
-    event_loop->event_current = NULL;
-    cnt = event_loop->epoll_get_cnt;
-    if (cnt <= 0) {
-        (void)memset(event_loop->epoll_events, 0,
-                sizeof(struct epoll_event) * event_loop->epoll_fd_max);
-        list_for_each_entry_safe(unused, event, &event_loop->event_unused, node) {
-            event_loop_remove_unused_event(unused);
-        }
-
-        while (1) {
-            cnt = epoll_wait(event_loop->epoll_fd, event_loop->epoll_events,
-                    event_loop->epoll_fd_max, 0);
-            if (cnt < 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
+    event_loop->busy_poll_usec = usec;
 
-                return NULL;
-            } else if (cnt == 0) {
-                if (event_loop->event_size != 0) {
-                    continue;
-                }
+    return 0;
+}
+
+int event_loop_set_backend(event_loop_t *event_loop, enum event_backend_e backend)
+{
+    const struct event_backend_ops_s *ops;
+
+    if (event_loop == NULL || event_loop->event_size != 0) {
+        return -1;
+    }
+
+    switch (backend) {
+    case EVENT_BACKEND_EPOLL:
+        ops = &event_backend_epoll;
+        break;
+    case EVENT_BACKEND_URING:
+        ops = &event_backend_uring;
+        break;
+    default:
+        return -1;
+    }
+
+    if (ops == event_loop->backend) {
+        return 0;
+    }
+
+    /* the old backend stays in place until the new one is up */
+    if (ops->init(event_loop) != 0) {
+        return -1;
+    }
+
+    /* only cancelled events can be left on the changelist */
+    event_loop->changes_size = 0;
+    event_loop->backend->fini(event_loop);
+    event_loop->backend = ops;
+
+    return 0;
+}
+
+const char *event_loop_backend_name(event_loop_t *event_loop)
+{
+    return event_loop->backend->name;
+}
+
+static void event_loop_free_unused(event_loop_t *event_loop)
+{
+    event_type_t *unused;
+    event_type_t *tmp;
 
-                return NULL;
+    list_for_each_entry_safe(unused, tmp, &event_loop->event_unused, node) {
+        event_loop_remove_unused_event(unused);
+    }
+}
+
+static int event_loop_fetch(event_loop_t *event_loop)
+{
+    int cnt;
+
+    event_loop_flush_outputs(event_loop);
+    event_loop_free_unused(event_loop);
+    event_loop_scratch_reset(event_loop);
+    event_loop_adjust_events(event_loop, event_loop->epoll_ready_cnt);
+    while (1) {
+        /* nothing left that could ever wake us up */
+        if (event_loop->event_size == 0) {
+            return -1;
+        }
+
+        /* handlers may have run for a while, don't sleep past the next timer */
+        if (event_timer_armed(event_loop)) {
+            event_loop_update_time(event_loop);
+        }
+
+        cnt = event_loop_poll(event_loop, event_timer_timeout(event_loop));
+        if (cnt < 0) {
+            if (errno != EINTR) {
+                return -1;
             }
 
+            cnt = 0;
+        }
+
+        event_loop_update_time(event_loop);
+        event_timer_run(event_loop);
+        if (cnt > 0 || !list_empty(&event_loop->timer_pending)) {
             break;
         }
     }
 
-    event_loop->epoll_get_cnt = --cnt;
-    event = (event_type_t *)event_loop->epoll_events[cnt].data.ptr;
-    event_loop->event_current = event;
+    event_loop->epoll_ready_cnt = cnt;
 
-    return event;
+    return cnt;
 }
 
-int event_loop_deal_event(event_type_t *event)
+event_type_t *event_loop_wait(event_loop_t *event_loop)
+{
+    int cnt;
+    event_type_t *event;
+
+    if (event_loop == NULL) {
+        return NULL;
+    }
+
+    event_loop->event_current = NULL;
+    while (1) {
+        while (event_loop->epoll_get_cnt > 0) {
+            cnt = --event_loop->epoll_get_cnt;
+            event = event_loop_handle_lookup(event_loop, event_loop->epoll_events[cnt].data.u64);
+            if (event != NULL) {
+                event->revents = event_loop->epoll_events[cnt].events;
+                event_loop->event_current = event;
+                return event;
+            }
+        }
+
+        /* timers run after the I/O of the same batch */
+        event = event_timer_pop(event_loop);
+        if (event != NULL) {
+            event_loop->event_current = event;
+            return event;
+        }
+
+        cnt = event_loop_fetch(event_loop);
+        if (cnt < 0) {
+            return NULL;
+        }
+
+        event_loop->epoll_get_cnt = cnt;
+    }
+}
+
+static int event_loop_dispatch_idle(event_loop_t *event_loop, event_type_t *event)
+{
+    int ret;
+    uint64_t deadline;
+
+    /* a paused event is held back, not idle */
+    if (event->flag & EVENT_F_PAUSED) {
+        event->touched = event_loop->time_now;
+    }
+
+    /* I/O of the same batch may have come after the timer expired */
+    deadline = event->touched + event->timer.interval;
+    if (deadline > event_loop->time_now) {
+        event_timer_arm(event_loop, event, deadline);
+        return 0;
+    }
+
+    event->touched = event_loop->time_now;
+    ret = event->timer.handler(event);
+    if (!(event->flag & EVENT_F_CANCEL) && event->timer.interval != 0
+            && !event_timer_queued(event)) {
+        event_timer_arm(event_loop, event, event_loop->time_now + event->timer.interval);
+    }
+
+    return ret;
+}
+
+static int event_loop_dispatch(event_loop_t *event_loop, event_type_t *event)
 {
     int ret;
+    int expired;
     uint64_t timer_calls;
     struct signalfd_siginfo fdsi;
     struct event_ps_hook_head_s *hook_head;
-    event_loop_t *event_loop;
-
-    if (event == NULL) {
-        return -1;
-    }
 
-    event_loop = event->loop;
-    if (event_loop == NULL || event->handler == NULL || event->fd < 0) {
-        return -1;
+    expired = event->flag & EVENT_F_EXPIRED;
+    event->flag &= ~EVENT_F_EXPIRED;
+    /* the kernel reported a oneshot event for the last time until re-armed */
+    if ((event->flag & EVENT_F_ARM_ONCE) && !expired) {
+        event->flag |= EVENT_F_DISARMED;
     }
 
     switch (event->type) {
     case EVENT_TYPE_TIMER:
-        ret = read(event->fd, &timer_calls, sizeof(uint64_t));
-        if (ret != sizeof(uint64_t)) {
-            event->data.timer_count = 0;
-            return 0;
+        /* count the periods that elapsed and queue the next one */
+        timer_calls = 1;
+        if (event->timer.interval != 0) {
+            timer_calls += (event_loop->time_now - event->timer.deadline) / event->timer.interval;
+            event_timer_arm(event_loop, event,
+                    event->timer.deadline + timer_calls * event->timer.interval);
         }
 
-        event->data.timer_count = timer_calls;
+        event->timer.count = timer_calls;
         break;
     case EVENT_TYPE_SIGNAL:
+        /* the signals stay queued in the signalfd */
+        if (event->flag & EVENT_F_PAUSED) {
+            return event_loop_mute_event(event_loop, event);
+        }
+
         ret = read(event->fd, &fdsi, sizeof(struct signalfd_siginfo));
         if (ret != sizeof(struct signalfd_siginfo)) {
-            event->data.sig.no = 0;
+            event->data.signo = 0;
             return 0;
         }
 
-        event->data.sig.no = fdsi.ssi_signo;
+        event->data.signo = fdsi.ssi_signo;
         break;
     case EVENT_TYPE_READ:
+        if (expired) {
+            return event_loop_dispatch_idle(event_loop, event);
+        }
+
+        if (event->revents & EPOLLOUT) {
+            (void)event_output_flush(event_loop, event);
+            /* only the queued output was waiting */
+            if (!(event->revents & ~EPOLLOUT)) {
+                return 0;
+            }
+        }
+
+        /* the idle timeout is pushed back lazily, nothing is re-armed here */
+        event->touched = event_loop->time_now;
+        if (event->flag & EVENT_F_PAUSED) {
+            return event_loop_mute_event(event_loop, event);
+        }
+
+        if (event->flag & EVENT_F_BUFFERED) {
+            return event_input_dispatch(event_loop, event);
+        }
+        break;
     case EVENT_TYPE_WRITE:
+        /* the handler hears about a drained backlog or a failed write */
+        if (event->stream != NULL && event->stream->output.blocked) {
+            (void)event_output_flush(event_loop, event);
+            if (event->stream->output.blocked) {
+                return 0;
+            }
+        }
+
+        if (event->flag & EVENT_F_PAUSED) {
+            return event_loop_mute_event(event_loop, event);
+        }
+        break;
     default:
         break;
     }
 
     ret = event->handler(event);
-    if (event->loop->event_ps_signal == event) {
+    if (event_loop->event_ps_signal == event) {
         hook_head = (struct event_ps_hook_head_s *)event_loop_event_arg(event);
         if (RB_EMPTY_ROOT(&hook_head->head)) {
-            free(hook_head);
-            event->arg = NULL;
             event_loop_cancel(event);
         }
     }
 
-    if (event->flag & EVENT_F_ONESHOT) {
+    /* a one-shot timer re-armed by its handler stays alive */
+    if ((event->flag & EVENT_F_ONESHOT) && !event_timer_queued(event)) {
         event_loop_cancel(event);
     }
 
+    return ret;
+}
+
+/* an event cancelled by its own handler is released as soon as the handler returns */
+static int event_loop_dispatch_current(event_loop_t *event_loop, event_type_t *event)
+{
+    int ret;
+
+    event_loop->event_current = event;
+    ret = event_loop_dispatch(event_loop, event);
+    event_loop->event_current = NULL;
     if (event->flag & EVENT_F_CANCEL) {
         event_loop_remove_unused_event(event);
     }
@@ -647,11 +2850,81 @@ int event_loop_deal_event(event_type_t *event)
     return ret;
 }
 
-void event_loop_run(event_loop_t *event_loop)
+int event_loop_deal_event(event_type_t *event)
+{
+    event_loop_t *event_loop;
+
+    if (event == NULL) {
+        return -1;
+    }
+
+    event_loop = event->loop;
+    if (event_loop == NULL || event->handler == NULL
+            || (event->fd < 0 && event->type != EVENT_TYPE_TIMER)) {
+        return -1;
+    }
+
+    if (event->flag & EVENT_F_CANCEL) {
+        return 0;
+    }
+
+    return event_loop_dispatch_current(event_loop, event);
+}
+
+int event_loop_run_once(event_loop_t *event_loop)
 {
+    int i;
+    int cnt;
+    int done;
+    struct epoll_event *events;
     event_type_t *event;
 
-    while ((event = event_loop_wait(event_loop)) != NULL) {
-        (void)event_loop_deal_event(event);
+    if (event_loop == NULL) {
+        return -1;
+    }
+
+    /* finish whatever event_loop_wait() left in the current batch first */
+    cnt = event_loop->epoll_get_cnt;
+    event_loop->epoll_get_cnt = 0;
+    if (cnt <= 0 && list_empty(&event_loop->timer_pending)) {
+        cnt = event_loop_fetch(event_loop);
+        if (cnt < 0) {
+            return -1;
+        }
+    }
+
+    events = event_loop->epoll_events;
+    for (i = 0; i < cnt; ++i) {
+        /* cancelled by an earlier handler of this batch */
+        event = event_loop_handle_lookup(event_loop, events[i].data.u64);
+        if (i + 1 < cnt) {
+            prefetch(event_loop_handle_lookup(event_loop, events[i + 1].data.u64));
+        }
+
+        if (event == NULL) {
+            continue;
+        }
+
+        event->revents = events[i].events;
+        (void)event_loop_dispatch_current(event_loop, event);
+    }
+
+    done = cnt;
+    while ((event = event_timer_pop(event_loop)) != NULL) {
+        (void)event_loop_dispatch_current(event_loop, event);
+        ++done;
+    }
+
+    event_loop->event_current = NULL;
+    event_loop_flush_outputs(event_loop);
+    event_loop_free_unused(event_loop);
+    event_loop_scratch_reset(event_loop);
+
+    return done;
+}
+
+void event_loop_run(event_loop_t *event_loop)
+{
+    while (event_loop_run_once(event_loop) >= 0) {
     }
 }
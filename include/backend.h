@@ -0,0 +1,68 @@
+#ifndef _BACKEND_H_
+#define _BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVENT_URING_SQ_ENTRIES          256
+#define EVENT_URING_CQ_ENTRIES          8192
+
+struct event_loop_s;
+struct event_type_s;
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct epoll_event;
+
+enum event_backend_e {
+    EVENT_BACKEND_EPOLL,        /* epoll_ctl per change, epoll_wait per iteration */
+    EVENT_BACKEND_URING,        /* multishot polls, changes and waits share one io_uring_enter */
+};
+
+/*
+ * I/O multiplexing used by the loop. Interest masks are EPOLL* bits,
+ * wait() fills events with the ready masks and the handles of the
+ * events and returns how many it stored.
+ */
+struct event_backend_ops_s {
+    const char         *name;
+    int               (*init)(struct event_loop_s *event_loop);
+    void              (*fini)(struct event_loop_s *event_loop);
+    int               (*add)(struct event_loop_s *event_loop, int fd, uint64_t handle,
+                              uint32_t events);
+    int               (*mod)(struct event_loop_s *event_loop, int fd, uint64_t handle,
+                              uint32_t events);
+    int               (*del)(struct event_loop_s *event_loop, int fd, uint64_t handle);
+    int               (*wait)(struct event_loop_s *event_loop, struct epoll_event *events,
+                               int size, int timeout);
+};
+
+/* io_uring rings mapped from the kernel */
+struct event_uring_s {
+    int                 fd;
+    unsigned int        sq_entries;
+    unsigned int        sq_mask;
+    unsigned int        cq_mask;
+    unsigned int        sq_pending;     /* queued and not submitted yet */
+    unsigned int       *sq_head;
+    unsigned int       *sq_tail;
+    unsigned int       *sq_flags;
+    unsigned int       *sq_array;
+    unsigned int       *cq_head;
+    unsigned int       *cq_tail;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void               *sq_ring;
+    size_t              sq_ring_size;
+    void               *cq_ring;
+    size_t              cq_ring_size;
+    size_t              sqes_size;
+};
+
+extern const struct event_backend_ops_s event_backend_epoll;
+
+extern const struct event_backend_ops_s event_backend_uring;
+
+/* the interest mask of an event, for backends that have to re-arm on their own */
+extern uint32_t event_loop_epoll_mask(struct event_type_s *event);
+
+#endif /* _BACKEND_H_ */
@@ -3,20 +3,115 @@
 
 #include <time.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/epoll.h>
+#include <sys/uio.h>
 #include <sys/types.h>
+#include "backend.h"
 #include "list.h"
 #include "rbtree.h"
+#include "slab.h"
 
 #define EVENT_LOOP_INLINE               __attribute__((always_inline)) static inline
 #define EVENT_TYPE_NAME_LEN             16
-#define EVENT_LOOP_MAX_SHIFT_BITS       10
+#define EVENT_CACHELINE_SIZE            64
+
+/* bounds of the epoll_wait result buffer, it adapts to the ready counts */
+#define EVENT_LOOP_EVENTS_MIN           64
+#define EVENT_LOOP_EVENTS_MAX           8192
+/* mostly empty waits in a row before the buffer is halved */
+#define EVENT_LOOP_EVENTS_SHRINK        1024
+/* initial size of the fd table, it doubles to fit the highest fd */
+#define EVENT_LOOP_FD_TABLE_MIN         64
+/* initial size of the handle table, it doubles when the freelist runs dry */
+#define EVENT_LOOP_HANDLE_TABLE_MIN     64
+/* interest changes recorded between waits, a full list is applied early */
+#define EVENT_LOOP_CHANGES_MAX          256
+/* the scratch arena starts this big and grows to the busiest batch up to the max */
+#define EVENT_LOOP_SCRATCH_MIN          (16 << 10)
+#define EVENT_LOOP_SCRATCH_MAX          (1 << 20)
+#define EVENT_LOOP_SCRATCH_ALIGN        16
+
+/* output queue segments, copies smaller than the inline space are coalesced */
+#define EVENT_OUTPUT_SEGMENT_SIZE       512
+/*
+ * Input rings borrow a buffer of this size from the loop-wide pool while
+ * they hold data and give it back once drained. Past it they double with
+ * malloc up to the limit of the event.
+ */
+#define EVENT_INPUT_BUFFER_SIZE         (16 << 10)
+/* buffers the pool maps at a time */
+#define EVENT_INPUT_BUFFER_CHUNK        4
+
+/*
+ * Fixed-capacity build, e.g. make FIXED_EVENTS=4096: the loop and all of
+ * its tables come from one locked mapping made by event_loop_create(),
+ * nothing is allocated afterwards and registration fails once full.
+ * FIXED_EVENTS bounds the registered events, intrusive ones included.
+ */
+#ifdef EVENT_LOOP_FIXED_EVENTS
+#define EVENT_LOOP_FIXED
+#ifndef EVENT_LOOP_FIXED_FDS
+#define EVENT_LOOP_FIXED_FDS            ((EVENT_LOOP_FIXED_EVENTS) + 64)
+#endif
+#ifndef EVENT_LOOP_FIXED_HOOKS
+#define EVENT_LOOP_FIXED_HOOKS          64
+#endif
+#ifndef EVENT_LOOP_FIXED_SIGNALS
+#define EVENT_LOOP_FIXED_SIGNALS        8
+#endif
+#ifndef EVENT_LOOP_FIXED_SCRATCH
+#define EVENT_LOOP_FIXED_SCRATCH        EVENT_LOOP_SCRATCH_MIN
+#endif
+#ifndef EVENT_LOOP_FIXED_STREAMS
+#define EVENT_LOOP_FIXED_STREAMS        (EVENT_LOOP_FIXED_EVENTS)
+#endif
+#ifndef EVENT_LOOP_FIXED_SEGMENTS
+#define EVENT_LOOP_FIXED_SEGMENTS       (EVENT_LOOP_FIXED_EVENTS)
+#endif
+/* input buffers in the pool, only events with data in flight hold one */
+#ifndef EVENT_LOOP_FIXED_BUFFERS
+#define EVENT_LOOP_FIXED_BUFFERS        64
+#endif
+#define EVENT_LOOP_FIXED_READY          \
+    ((EVENT_LOOP_FIXED_EVENTS) < EVENT_LOOP_EVENTS_MAX ? (EVENT_LOOP_FIXED_EVENTS) : EVENT_LOOP_EVENTS_MAX)
+#endif
 
 #define SIGNAL_SIZE                     (sizeof(sigset_t) << 3)
 
+#define EVENT_NSEC_PER_SEC              1000000000ULL
+#define EVENT_NSEC_PER_MSEC             1000000ULL
+#define EVENT_NSEC_PER_USEC             1000ULL
+
+/* hierarchical timer wheel: 256 slots of one tick plus 4 levels of 64 slots */
+#define EVENT_TIMER_TICK_NSEC           EVENT_NSEC_PER_MSEC
+#define EVENT_TIMER_TVR_BITS            8
+#define EVENT_TIMER_TVN_BITS            6
+#define EVENT_TIMER_TVN_LEVELS          4
+#define EVENT_TIMER_TVR_SIZE            (1 << EVENT_TIMER_TVR_BITS)
+#define EVENT_TIMER_TVN_SIZE            (1 << EVENT_TIMER_TVN_BITS)
+#define EVENT_TIMER_TVR_MASK            (EVENT_TIMER_TVR_SIZE - 1)
+#define EVENT_TIMER_TVN_MASK            (EVENT_TIMER_TVN_SIZE - 1)
+#define EVENT_TIMER_MAX_TICKS           \
+    ((1ULL << (EVENT_TIMER_TVR_BITS + EVENT_TIMER_TVN_LEVELS * EVENT_TIMER_TVN_BITS)) - 1)
+
 typedef struct event_loop_s event_loop_t;
 typedef struct event_type_s event_type_t;
 typedef int (*event_func_t)(event_type_t *);
+typedef void (*event_free_func_t)(void *ctx);
+
+/*
+ * Slot index in the low 32 bits, its generation in the high 32 bits. The
+ * generation is bumped when the event is cancelled, so a stale handle never
+ * resolves to whatever reuses the slot. Generations start at 1, 0 is never
+ * a valid handle.
+ */
+typedef uint64_t event_handle_t;
+
+#define EVENT_HANDLE_INVALID            ((event_handle_t)0)
+#define EVENT_HANDLE_INDEX(h)           ((uint32_t)(h))
+#define EVENT_HANDLE_GEN(h)             ((uint32_t)((h) >> 32))
+#define EVENT_HANDLE_MAKE(gen, index)   (((event_handle_t)(gen) << 32) | (uint32_t)(index))
 
 enum event_type_e {
     EVENT_TYPE_READ,
@@ -26,11 +121,6 @@ enum event_type_e {
     EVENT_TYPE_LINUX_EVENT,
 };
 
-struct event_sig_s {
-    sigset_t            set;
-    int                 no;
-};
-
 typedef int (*event_ps_func_t)(int exit_code, void *arg);
 
 struct event_ps_hook_s {
@@ -45,45 +135,222 @@ struct event_ps_hook_head_s {
     size_t              size;
 };
 
+enum event_trigger_e {
+    EVENT_TRIGGER_EDGE,         /* default, reported once per readiness change */
+    EVENT_TRIGGER_LEVEL,        /* reported by every wait while ready */
+    EVENT_TRIGGER_ONESHOT,      /* disabled after each report until re-armed */
+    EVENT_TRIGGER_EXCLUSIVE,    /* level, one of the loops sharing the fd is woken */
+};
+
+enum event_timer_engine_e {
+    EVENT_TIMER_WHEEL,          /* O(1) arm and cancel, one tick granularity */
+    EVENT_TIMER_RBTREE,         /* O(log n) arm and cancel, exact deadlines */
+};
+
+struct event_timer_s {
+    struct list_head    node;
+    struct rb_node      rb;
+    uint64_t            deadline;   /* CLOCK_MONOTONIC, ns */
+    uint64_t            interval;   /* ns, 0 for one-shot timers */
+    uint64_t            slack;      /* ns the timer may fire late */
+    uint64_t            expires;    /* deadline plus slack, a tick on the wheel, ns on the rbtree */
+    uint64_t            count;      /* periods elapsed at the last expiry */
+    event_func_t        handler;    /* idle timeout handler of read events */
+};
+
+struct event_timer_wheel_s {
+    uint64_t            jiffies;    /* next tick to run */
+    size_t              size;
+    struct list_head    tv1[EVENT_TIMER_TVR_SIZE];
+    struct list_head    tvn[EVENT_TIMER_TVN_LEVELS][EVENT_TIMER_TVN_SIZE];
+};
+
+struct event_timer_tree_s {
+    struct rb_root_cached root;
+    size_t              size;
+};
+
+struct event_handle_slot_s {
+    event_type_t       *event;      /* NULL while the slot is free */
+    uint32_t            gen;
+    uint32_t            next;       /* freelist link */
+};
+
+/* allocations that did not fit in the arena, freed at the next reset */
+struct event_scratch_chunk_s {
+    struct event_scratch_chunk_s *next;
+};
+
+struct event_scratch_s {
+    char               *base;
+    size_t              size;
+    size_t              used;
+    size_t              peak;       /* bytes handed out in this batch, overflow included */
+    struct event_scratch_chunk_s *overflow;
+};
+
+/* one buffer of the output queue, either borrowed or copied inline */
+struct event_output_segment_s {
+    struct list_head    node;
+    const char         *base;       /* first byte not written yet */
+    size_t              len;        /* bytes left from base */
+    event_free_func_t   release;    /* borrowed buffers only */
+    void               *ctx;
+    size_t              fill;       /* bytes used in data, 0 when borrowed */
+    char                data[];
+};
+
+#define EVENT_OUTPUT_INLINE_SIZE        \
+    (EVENT_OUTPUT_SEGMENT_SIZE - sizeof(struct event_output_segment_s))
+
+struct event_output_s {
+    struct list_head    segments;
+    struct list_head    dirty;      /* on output_dirty while data waits for the batch end */
+    size_t              bytes;
+    int                 error;      /* errno of the failed write, the queue is dropped */
+    int                 blocked;    /* the kernel buffer was full, EPOLLOUT is armed */
+};
+
+/* ring of received bytes, head and tail run freely and are masked by size - 1 */
+struct event_input_s {
+    char               *data;
+    size_t              size;       /* a power of two, 0 until the first read */
+    size_t              limit;      /* the ring never grows past this */
+    size_t              head;       /* first byte not consumed */
+    size_t              tail;       /* one past the last byte received */
+    int                 eof;
+    int                 error;      /* errno of the failed read */
+};
+
+/* buffered I/O of a read or write event, allocated on first use */
+struct event_stream_s {
+    event_type_t       *event;
+    struct event_output_s output;
+    struct event_input_s input;
+};
+
 union event_data_u {
     void               *ptr;
-    struct event_sig_s  sig;
-    uint64_t            timer_count;
+    int                 signo;
 };
 
+/*
+ * The first cache line holds everything event_loop_deal_event() touches,
+ * the timer takes the next ones and what is rarely used comes last.
+ */
 struct event_type_s {
-    struct list_head    node;
     enum event_type_e   type;
-    event_func_t        handler;
-    event_loop_t       *loop;
-    void               *arg;
-
 #define EVENT_F_ONESHOT                 (1 << 0)
 #define EVENT_F_CANCEL                  (1 << 1)
+#define EVENT_F_PENDING                 (1 << 2)
+#define EVENT_F_EXPIRED                 (1 << 3)
+#define EVENT_F_EXTERNAL                (1 << 4)
+#define EVENT_F_BUFFERED                (1 << 5)
+#define EVENT_F_CHANGED                 (1 << 6)    /* on the changelist */
+#define EVENT_F_ACTIVE                  (1 << 7)    /* registered with the backend */
+#define EVENT_F_LEVEL                   (1 << 8)
+#define EVENT_F_ARM_ONCE                (1 << 9)
+#define EVENT_F_EXCLUSIVE               (1 << 10)
+#define EVENT_F_DISARMED                (1 << 11)   /* reported since last armed */
+#define EVENT_F_PAUSED                  (1 << 12)
+#define EVENT_F_MUTED                   (1 << 13)   /* input interest dropped while paused */
+#define EVENT_F_TRIGGER                 (EVENT_F_LEVEL | EVENT_F_ARM_ONCE | EVENT_F_EXCLUSIVE)
     int                 flag;
     int                 fd;
+    uint32_t            revents;    /* epoll events of the current dispatch */
+    event_func_t        handler;
+    void               *arg;
+    event_loop_t       *loop;
     union event_data_u  data;
+    uint64_t            touched;    /* loop time of the last read dispatch */
+    event_handle_t      handle;     /* also the epoll data, checked before dispatch */
+
+    struct event_timer_s timer __attribute__((aligned(EVENT_CACHELINE_SIZE)));
+
+    struct list_head    node;
+    union {
+        sigset_t       *sigset;     /* signal events */
+        struct event_stream_s *stream;  /* buffered I/O of read and write events */
+    };
     char                name[EVENT_TYPE_NAME_LEN];
-};
+} __attribute__((aligned(EVENT_CACHELINE_SIZE)));
 
 struct event_loop_s {
     size_t              event_size;
     struct list_head    event_head;
 
+    /* events cancelled by their own handler wait here until it returns */
     struct list_head    event_unused;
+    struct slab_cache_s event_slab;
+    struct slab_cache_s hook_slab;
+    struct slab_cache_s sigset_slab;
+    struct slab_cache_s stream_slab;
+    struct slab_cache_s segment_slab;
+    /* input buffers lent to read events while they have unconsumed data */
+    struct slab_cache_s buffer_slab;
+    /* read events that found the pool empty, re-reported as buffers come back */
+    struct list_head    buffer_wait;
+
+    /* outputs with data to write before the next wait */
+    struct list_head    output_dirty;
+
+    /* the one mapping everything lives in for fixed-capacity builds, else NULL */
+    void               *fixed_map;
+    size_t              fixed_size;
 
     event_type_t       *event_current;
 
+    /* the event registered on each fd, indexed by fd */
+    event_type_t      **fd_table;
+    int                 fd_table_size;
+
+    /* live events by handle index, free slots are chained from handle_free */
+    struct event_handle_slot_s *handle_table;
+    uint32_t            handle_table_size;
+    uint32_t            handle_free;
+
     sigset_t            event_sigset;
 
 
     event_type_t       *event_ps_signal;
-
+    struct event_ps_hook_head_s ps_hooks;
+
+    const struct event_backend_ops_s *backend;
+    struct event_uring_s uring;
+    /*
+     * handles of the events whose interest changed since the last wait,
+     * an event cancelled before the wait is never registered at all
+     */
+    event_handle_t      changes[EVENT_LOOP_CHANGES_MAX];
+    int                 changes_size;
+    /*
+     * events the loop reports on its own ahead of the next wait, with the
+     * revents they carry: EPOLLERR when the backend refused them, EPOLLIN
+     * when resumed with buffered input or when a pool buffer came back
+     */
+    struct list_head    report_pending;
     int                 epoll_fd;
-    int                 epoll_volume;
-    int                 epoll_fd_max;
     struct epoll_event *epoll_events;
+    int                 epoll_events_size;
+    int                 epoll_events_idle;
+    int                 epoll_ready_cnt;
     int                 epoll_get_cnt;
+
+    /* CLOCK_MONOTONIC in ns, captured once each time epoll_wait returns */
+    uint64_t            time_now;
+    enum event_timer_engine_e timer_engine;
+    struct event_timer_wheel_s timer_wheel;
+    struct event_timer_tree_s timer_tree;
+    /* slack given to the timers created from now on */
+    uint64_t            timer_slack;
+    /* expired timers waiting to be dispatched */
+    struct list_head    timer_pending;
+
+    /* spin with a zero timeout for this long before blocking in epoll_wait */
+    unsigned int        busy_poll_usec;
+
+    /* bump allocator for handlers, emptied when the batch is over */
+    struct event_scratch_s scratch;
 };
 
 EVENT_LOOP_INLINE int event_loop_event_fd(event_type_t *event)
@@ -91,6 +358,22 @@ EVENT_LOOP_INLINE int event_loop_event_fd(event_type_t *event)
     return event->fd;
 }
 
+/*
+ * the EPOLL* bits of the current dispatch, 0 for timers and idle timeouts;
+ * read events also get EPOLLRDHUP once the peer shut down its side, except
+ * exclusive ones
+ */
+EVENT_LOOP_INLINE uint32_t event_loop_event_revents(event_type_t *event)
+{
+    return event->revents;
+}
+
+/* stays EVENT_HANDLE_INVALID until the event is registered */
+EVENT_LOOP_INLINE event_handle_t event_loop_event_handle(event_type_t *event)
+{
+    return event->handle;
+}
+
 EVENT_LOOP_INLINE void *event_loop_event_arg(event_type_t *event)
 {
     return event->arg;
@@ -98,7 +381,12 @@ EVENT_LOOP_INLINE void *event_loop_event_arg(event_type_t *event)
 
 EVENT_LOOP_INLINE int event_loop_event_signo(event_type_t *event)
 {
-    return event->data.sig.no;
+    return event->data.signo;
+}
+
+EVENT_LOOP_INLINE uint64_t event_loop_event_timer_count(event_type_t *event)
+{
+    return event->timer.count;
 }
 
 EVENT_LOOP_INLINE const char *event_loop_event_name(event_type_t *event)
@@ -106,19 +394,149 @@ EVENT_LOOP_INLINE const char *event_loop_event_name(event_type_t *event)
     return event->name;
 }
 
+/* bytes queued by event_loop_write*() and not written yet */
+EVENT_LOOP_INLINE size_t event_loop_output_pending(event_type_t *event)
+{
+    if (event->type != EVENT_TYPE_READ && event->type != EVENT_TYPE_WRITE) {
+        return 0;
+    }
+
+    return event->stream == NULL ? 0 : event->stream->output.bytes;
+}
+
+/* CLOCK_MONOTONIC in ns as of the current iteration, timers are armed from it */
+EVENT_LOOP_INLINE uint64_t event_loop_now(event_loop_t *event_loop)
+{
+    return event_loop->time_now;
+}
+
 extern event_loop_t *event_loop_create(void);
 
+/* refresh event_loop_now(), for handlers that run long before arming timers */
+extern void event_loop_update_time(event_loop_t *event_loop);
+
 extern event_type_t *event_loop_wait(event_loop_t *event_loop);
 
 extern int event_loop_deal_event(event_type_t *event);
 
+/* wait once and dispatch the whole ready set, return the count or -1 */
+extern int event_loop_run_once(event_loop_t *event_loop);
+
 extern void event_loop_run(event_loop_t *event_loop);
 
+/* 0 (default) blocks right away, otherwise poll for usec before blocking */
+extern int event_loop_set_busy_poll(event_loop_t *event_loop, unsigned int usec);
+
+/*
+ * switch the readiness backend, only while no event is registered;
+ * on failure the loop stays on epoll and -1 is returned
+ */
+extern int event_loop_set_backend(event_loop_t *event_loop, enum event_backend_e backend);
+
+extern const char *event_loop_backend_name(event_loop_t *event_loop);
+
 extern void event_loop_destroy(event_loop_t *event_loop);
 
+/*
+ * Memory that lives until the current batch has been dispatched, it must
+ * not be freed. Aligned to EVENT_LOOP_SCRATCH_ALIGN, NULL on failure.
+ */
+extern void *event_loop_scratch_alloc(event_loop_t *event_loop, size_t size);
+
+/*
+ * Events in caller-provided storage, e.g. embedded in a connection struct:
+ * no allocation is done by the loop. Read, write and timer events only,
+ * timers start disarmed and are armed with event_loop_alter_timer*().
+ * The storage may be released once the event is stopped, an event stopped
+ * by its own handler is only released when that handler has returned.
+ */
+extern int event_loop_event_init(event_type_t *event, enum event_type_e type,
+        event_func_t handler, const char *name, void *arg, int fd);
+
+extern int event_loop_event_start(event_loop_t *event_loop, event_type_t *event);
+
+extern void event_loop_event_stop(event_type_t *event);
+
+/*
+ * fd events reach the backend right before the next wait; if it refuses
+ * the fd, the handler runs once with EPOLLERR in revents
+ */
 extern event_type_t *event_loop_create_read(event_loop_t *event_loop,
         event_func_t handler, const char *name, void *arg, int fd);
 
+/*
+ * A write-only event, EPOLLOUT is only armed while queued data does not
+ * fit in the kernel buffer. handler runs once such a backlog has drained
+ * or the write failed.
+ */
+extern event_type_t *event_loop_create_write(event_loop_t *event_loop,
+        event_func_t handler, const char *name, void *arg, int fd);
+
+/*
+ * Queue data on a read or write event, it is written with writev when the
+ * batch is over. Small writes are copied and coalesced, event_loop_write_ref()
+ * borrows buf until release(ctx) is called. Queued data is dropped when the
+ * event is cancelled, SIGPIPE is left to the application.
+ */
+extern int event_loop_write(event_type_t *event, const void *buf, size_t len);
+
+extern int event_loop_write_ref(event_type_t *event, const void *buf, size_t len,
+        event_free_func_t release, void *ctx);
+
+/* write the queue now instead of at the end of the batch */
+extern int event_loop_flush(event_type_t *event);
+
+/*
+ * Buffered reads: the loop drains the fd into a ring of up to limit bytes
+ * before calling the handler, which looks at the data with
+ * event_loop_input_peek() and drops what it used with
+ * event_loop_input_consume(). While the ring is full and the handler keeps
+ * consuming it is called again, a message must fit in limit. A zero limit
+ * goes back to plain reads and drops the ring, from the handler an fd left
+ * undrained is reported again for plain reads. Storage is only held while
+ * data is buffered, fixed-capacity builds cap limit at one pool buffer.
+ */
+extern event_type_t *event_loop_alter_read_buffer(event_type_t *event, size_t limit);
+
+/* the buffered bytes as at most two contiguous views, return their total */
+extern size_t event_loop_input_peek(event_type_t *event, struct iovec iov[2]);
+
+extern size_t event_loop_input_consume(event_type_t *event, size_t len);
+
+/* 1 once the peer closed, -1 once a read failed, the buffered data stays readable */
+extern int event_loop_input_eof(event_type_t *event);
+
+/*
+ * how readiness of an fd event is reported, edge by default; exclusive
+ * is for listeners added to several loops and costs a delete and add to
+ * change afterwards
+ */
+extern event_type_t *event_loop_alter_trigger(event_type_t *event, enum event_trigger_e trigger);
+
+/*
+ * enable a oneshot event again once its last report has been handled,
+ * queued output keeps draining while it is disabled
+ */
+extern int event_loop_event_rearm(event_type_t *event);
+
+/*
+ * stop calling the handler of an fd event until it is resumed, queued
+ * output still drains; nothing reaches the kernel unless a report comes
+ * in meanwhile, then the input interest is dropped with one modify
+ */
+extern int event_loop_event_pause(event_type_t *event);
+
+/* readiness and buffered input left over from the pause are reported again */
+extern int event_loop_event_resume(event_type_t *event);
+
+/*
+ * call handler once the read event has not been dispatched for timeout,
+ * a zero timeout turns it off; activity only stamps the event, the timer
+ * is re-armed lazily when it would have expired
+ */
+extern event_type_t *event_loop_alter_idle_timeout(event_type_t *event, struct timespec timeout,
+        event_func_t handler);
+
 extern event_type_t *event_loop_create_timer(event_loop_t *event_loop,
         event_func_t handler, const char *name, void *arg, time_t time);
 
@@ -141,10 +559,45 @@ extern event_type_t *event_loop_create_linux_event(event_loop_t *event_loop,
 extern pid_t event_loop_create_process(event_loop_t *event_loop,
         event_ps_func_t handler, void *arg, char *exec_name, char **exec_arg);
 
+/* only allowed while no timer is armed, EVENT_TIMER_WHEEL by default */
+extern int event_loop_set_timer_engine(event_loop_t *event_loop,
+        enum event_timer_engine_e engine);
+
+/* fire after time from now, a loop timer also takes time as its new period */
 extern event_type_t *event_loop_alter_timer(event_type_t *event, struct timespec time);
 
+/* re-arm with a new value and period, a zero it_interval makes it one-shot */
+extern event_type_t *event_loop_alter_timer_itimerspec(event_type_t *event, struct itimerspec time);
+
+/* let timers fire up to slack late so that close deadlines share one wakeup */
+extern int event_loop_set_timer_slack(event_loop_t *event_loop, struct timespec slack);
+
+extern event_type_t *event_loop_alter_timer_slack(event_type_t *event, struct timespec slack);
+
+/* the mask must not overlap other signal events, SIGCHLD's event can't be altered */
 extern event_type_t *event_loop_alter_signal(event_type_t *event, const sigset_t *mask);
 
+/* chunks allocated from now on are backed by huge pages when possible */
+extern int event_loop_set_slab_hugepage(event_loop_t *event_loop, int enable);
+
+/* occupancy of the event and process hook slabs, either pointer may be NULL */
+extern int event_loop_slab_stats(event_loop_t *event_loop, struct slab_stats_s *events,
+        struct slab_stats_s *ps_hooks);
+
+/* occupancy of the input buffer pool */
+extern int event_loop_buffer_stats(event_loop_t *event_loop, struct slab_stats_s *buffers);
+
+/* O(1) lookup through the fd table, timers have no fd and are never found */
+extern event_type_t *event_loop_find_by_fd(event_loop_t *event_loop, int fd);
+
+extern int event_loop_cancel_by_fd(event_loop_t *event_loop, int fd);
+
+/* NULL once the event behind the handle has been cancelled */
+extern event_type_t *event_loop_handle_get(event_loop_t *event_loop, event_handle_t handle);
+
+/* -1 when the handle is stale, safe to call with a handle kept across iterations */
+extern int event_loop_handle_cancel(event_loop_t *event_loop, event_handle_t handle);
+
 /* allow to invoke this function repeatly */
 extern void event_loop_cancel(event_type_t *event);
 
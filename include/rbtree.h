@@ -13,6 +13,11 @@ struct rb_root {
     struct rb_node *rb_node;
 };
 
+struct rb_root_cached {
+    struct rb_root rb_root;
+    struct rb_node *rb_leftmost;
+};
+
 #define rb_parent(rb)       ((struct rb_node *)(((char *)NULL) + (((rb)->rb_parent_color & ~3))))
 #define rb_color(rb)        ((rb)->rb_parent_color & 1)
 #define rb_is_red(rb)       (!rb_color(rb))
@@ -39,6 +44,8 @@ __attribute__((always_inline)) static inline void rb_set_parent_color(struct rb_
 #define rb_entry(ptr, type, m)  ((type *)((((char *)(ptr)) - ((char *)&((type *)0)->m))))
 
 #define RB_ROOT             (struct rb_root){NULL,}
+#define RB_ROOT_CACHED      (struct rb_root_cached){{NULL,}, NULL}
+#define rb_first_cached(root)   ((root)->rb_leftmost)
 #define RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
 #define RB_EMPTY_NODE(rb)   ((rb)->rb_parent_color == (size_t)(((char *)(rb)) - ((char *)NULL)))
 #define RB_CLEAR_NODE(rb)   ((rb)->rb_parent_color = (size_t)(((char *)(rb)) - ((char *)NULL)))
@@ -64,6 +71,9 @@ typedef void (*rb_augment_f)(struct rb_node *node, void *data);
 extern void rb_insert_color(struct rb_node *, struct rb_root *);
 extern void rb_erase(struct rb_node *, struct rb_root *);
 
+extern void rb_insert_color_cached(struct rb_node *, struct rb_root_cached *, int);
+extern void rb_erase_cached(struct rb_node *, struct rb_root_cached *);
+
 extern void rb_augment_insert(struct rb_node *, rb_augment_f, void *);
 extern struct rb_node *rb_augment_erase_begin(struct rb_node *);
 extern void rb_augment_erase_end(struct rb_node *, rb_augment_f, void *);
@@ -0,0 +1,62 @@
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <stddef.h>
+
+#define SLAB_ALIGN                      64
+#define SLAB_CHUNK_SIZE                 (64 << 10)
+#define SLAB_HUGE_CHUNK_SIZE            (2 << 20)
+
+/* back new chunks with huge pages, falls back to transparent huge pages */
+#define SLAB_F_HUGEPAGE                 (1 << 0)
+/* objects come from memory given to slab_init_fixed(), the cache never grows */
+#define SLAB_F_FIXED                    (1 << 1)
+
+/*
+ * A cache of fixed size objects carved from contiguous chunks. Every object
+ * starts on a cache line, free objects are kept on a LIFO freelist linked
+ * through the objects themselves, chunks are only released by slab_destroy.
+ */
+struct slab_chunk_s {
+    struct slab_chunk_s *next;
+    size_t              size;
+};
+
+struct slab_cache_s {
+    size_t              obj_size;
+    int                 flags;
+    size_t              chunk_size;
+    size_t              chunks;
+    size_t              total;
+    size_t              used;
+    struct slab_chunk_s *chunk_head;
+    void               *free;
+};
+
+struct slab_stats_s {
+    size_t              obj_size;
+    size_t              chunks;
+    size_t              total;
+    size_t              used;
+};
+
+extern void slab_init(struct slab_cache_s *cache, size_t obj_size, int flags);
+
+/* size new chunks to hold exactly count objects instead of the default chunk size */
+extern void slab_set_chunk_count(struct slab_cache_s *cache, size_t count);
+
+/* carve count objects out of mem, which must be SLAB_ALIGN aligned and stays owned by the caller */
+extern void slab_init_fixed(struct slab_cache_s *cache, size_t obj_size, void *mem, size_t count);
+
+/* bytes slab_init_fixed() needs for count objects */
+extern size_t slab_fixed_size(size_t obj_size, size_t count);
+
+extern void *slab_alloc(struct slab_cache_s *cache);
+
+extern void slab_free(struct slab_cache_s *cache, void *obj);
+
+extern void slab_stats(const struct slab_cache_s *cache, struct slab_stats_s *stats);
+
+extern void slab_destroy(struct slab_cache_s *cache);
+
+#endif /* _SLAB_H_ */
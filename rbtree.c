@@ -259,6 +259,26 @@ void rb_erase(struct rb_node *node, struct rb_root *root)
         __rb_erase_color(child, parent, root);
 }
 
+/*
+ * Cached variants: the leftmost node is kept in rb_root_cached so that
+ * rb_first_cached() is O(1). The caller tells rb_insert_color_cached()
+ * whether it only ever walked left on the way down.
+ */
+void rb_insert_color_cached(struct rb_node *node, struct rb_root_cached *root,
+            int leftmost)
+{
+    if (leftmost)
+        root->rb_leftmost = node;
+    rb_insert_color(node, &root->rb_root);
+}
+
+void rb_erase_cached(struct rb_node *node, struct rb_root_cached *root)
+{
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = rb_next(node);
+    rb_erase(node, &root->rb_root);
+}
+
 static void rb_augment_path(struct rb_node *node, rb_augment_f func, void *data)
 {
     struct rb_node *parent;
@@ -0,0 +1,166 @@
+#include <sys/mman.h>
+#include "slab.h"
+
+void slab_init(struct slab_cache_s *cache, size_t obj_size, int flags)
+{
+    if (obj_size < sizeof(void *)) {
+        obj_size = sizeof(void *);
+    }
+
+    cache->obj_size = (obj_size + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1);
+    cache->flags = flags;
+    cache->chunk_size = 0;
+    cache->chunks = 0;
+    cache->total = 0;
+    cache->used = 0;
+    cache->chunk_head = NULL;
+    cache->free = NULL;
+}
+
+void slab_set_chunk_count(struct slab_cache_s *cache, size_t count)
+{
+    /* the header takes the first cache line */
+    cache->chunk_size = count != 0 ? SLAB_ALIGN + count * cache->obj_size : 0;
+}
+
+size_t slab_fixed_size(size_t obj_size, size_t count)
+{
+    if (obj_size < sizeof(void *)) {
+        obj_size = sizeof(void *);
+    }
+
+    return ((obj_size + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1)) * count;
+}
+
+static void slab_link(struct slab_cache_s *cache, char *mem, size_t count)
+{
+    size_t i;
+    char *obj;
+
+    /* push in reverse so that objects are handed out in address order */
+    obj = mem + (count - 1) * cache->obj_size;
+    for (i = 0; i < count; ++i, obj -= cache->obj_size) {
+        *(void **)obj = cache->free;
+        cache->free = obj;
+    }
+
+    cache->total += count;
+}
+
+void slab_init_fixed(struct slab_cache_s *cache, size_t obj_size, void *mem, size_t count)
+{
+    slab_init(cache, obj_size, SLAB_F_FIXED);
+    if (mem != NULL && count != 0) {
+        slab_link(cache, (char *)mem, count);
+    }
+}
+
+static struct slab_chunk_s *slab_map_chunk(size_t size, int flags)
+{
+    void *mem;
+
+    if (flags & SLAB_F_HUGEPAGE) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            return (struct slab_chunk_s *)mem;
+        }
+    }
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (flags & SLAB_F_HUGEPAGE) {
+        (void)madvise(mem, size, MADV_HUGEPAGE);
+    }
+
+    return (struct slab_chunk_s *)mem;
+}
+
+static int slab_grow(struct slab_cache_s *cache)
+{
+    size_t size;
+    struct slab_chunk_s *chunk;
+
+    if (cache->flags & SLAB_F_FIXED) {
+        return -1;
+    }
+
+    if (cache->chunk_size != 0) {
+        size = cache->chunk_size;
+    } else {
+        size = (cache->flags & SLAB_F_HUGEPAGE) ? SLAB_HUGE_CHUNK_SIZE : SLAB_CHUNK_SIZE;
+    }
+
+    if (size < SLAB_ALIGN + cache->obj_size) {
+        size = SLAB_ALIGN + cache->obj_size;
+    }
+
+    chunk = slab_map_chunk(size, cache->flags);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    chunk->size = size;
+    chunk->next = cache->chunk_head;
+    cache->chunk_head = chunk;
+    ++cache->chunks;
+
+    /* the header takes the first cache line */
+    slab_link(cache, (char *)chunk + SLAB_ALIGN, (size - SLAB_ALIGN) / cache->obj_size);
+
+    return 0;
+}
+
+void *slab_alloc(struct slab_cache_s *cache)
+{
+    void *obj;
+
+    if (cache->free == NULL && slab_grow(cache) != 0) {
+        return NULL;
+    }
+
+    obj = cache->free;
+    cache->free = *(void **)obj;
+    ++cache->used;
+
+    return obj;
+}
+
+void slab_free(struct slab_cache_s *cache, void *obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+
+    *(void **)obj = cache->free;
+    cache->free = obj;
+    --cache->used;
+}
+
+void slab_stats(const struct slab_cache_s *cache, struct slab_stats_s *stats)
+{
+    stats->obj_size = cache->obj_size;
+    stats->chunks = cache->chunks;
+    stats->total = cache->total;
+    stats->used = cache->used;
+}
+
+void slab_destroy(struct slab_cache_s *cache)
+{
+    struct slab_chunk_s *chunk;
+    struct slab_chunk_s *next;
+
+    for (chunk = cache->chunk_head; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        (void)munmap(chunk, chunk->size);
+    }
+
+    cache->chunk_head = NULL;
+    cache->free = NULL;
+    cache->chunks = 0;
+    cache->total = 0;
+    cache->used = 0;
+}